@@ -23,6 +23,7 @@ UMDSST_BIN_DIR=/home/tsluka/work/umdsst/umd-sst.release/bin
 OBS_FILE=$EXP_DIR/obs/%Y%m%d%H0000-ESACCI-L3C_GHRSST-SSTskin-AVHRR19_G-CDR2.1_night-v02.0-fv01.0.nc
 
 OBS_THINNING=0.8 # percent of obs to discard (range: 0.0 - 1.0 )
+OBS_SUPEROB=0    # 1 to average the obs onto the grid instead of thinning them
 
 # initial background used for the first cycle
 IC_FILE=$UMDSST_SRC_DIR/test/Data/19850101_regridded_sst.nc
@@ -43,7 +44,6 @@ SCRATCH_DIR=$EXP_DIR/SCRATCH
 # you probably dont need to edit anything below here...
 
 # define some other variables used by this script
-export OMP_NUM_THREADS=1  # OpenMP isn't working correctly, disable
 DA_WINDOW_LEN=24          # assuming a fixed window of 1 day, for now
 
 #================================================================================
@@ -103,27 +103,37 @@ while true; do
         ln -s $EXP_DIR/ana/ana.$PREV_DATE_YMDH.nc bkg.nc
     fi
 
-    # initialize bump if not already done so
-    BUMP_DIR=$EXP_DIR/bump
-    if [[ ! -d "$BUMP_DIR" ]]; then
-        echo "Initializing BUMP..."
-        mkdir bump
-        cp $EXP_DIR/config/staticbinit.yaml .
-        mpirun $UMDSST_BIN_DIR/umdsst_staticbinit.x staticbinit.yaml
-        mv bump $BUMP_DIR
-    fi
-    ln -s $BUMP_DIR bump
+    # BUMP NICAS data is cached across cycles, and recomputed by the var
+    # whenever its inputs (grid, mask, correlation lengths) change
+    mkdir -p $EXP_DIR/bump_cache
+    ln -s $EXP_DIR/bump_cache bump_cache
 
     # run ioda converter
     obs_file=$(date -ud "$ANA_DATE" +$OBS_FILE)
-    $UMDSST_BIN_DIR/gds2_sst2ioda.py -i $obs_file -o obs_ioda.nc \
-        -d $ANA_DATE_YMDH --sst -t $OBS_THINNING
+    if [[ "$OBS_SUPEROB" == 1 ]]; then
+        $UMDSST_BIN_DIR/gds2_sst2ioda.py -i $obs_file -o obs_raw.nc \
+            -d $ANA_DATE_YMDH --sst -t 0.0
+        cp $EXP_DIR/config/superob.yaml .
+        sed -i "s/__DA_WINDOW_START__/${DA_WINDOW_START}/g" superob.yaml
+        mpirun $UMDSST_BIN_DIR/umdsst_superob.x superob.yaml
+        mv obs_ioda_0000.nc obs_ioda.nc  # ioda adds the rank of the writer
+    else
+        $UMDSST_BIN_DIR/gds2_sst2ioda.py -i $obs_file -o obs_ioda.nc \
+            -d $ANA_DATE_YMDH --sst -t $OBS_THINNING
+    fi
 
     # run the var
     mkdir -p obs_out
     cp $EXP_DIR/config/var.yaml .
     sed -i "s/__DA_WINDOW_START__/${DA_WINDOW_START}/g" var.yaml
     sed -i "s/__ANA_DATE__/${ANA_DATE}/g" var.yaml
+    # the raw obs get an initial error, the superobs keep their own
+    if [[ "$OBS_SUPEROB" == 1 ]]; then
+        obs_error_action="{name: inflate error, inflation factor: 1.0}"
+    else
+        obs_error_action="{name: assign error, error parameter: 1.0}"
+    fi
+    sed -i "s/__OBS_ERROR_ACTION__/${obs_error_action}/g" var.yaml
     mpirun $UMDSST_BIN_DIR/umdsst_var.x var.yaml
 
     # move the output files
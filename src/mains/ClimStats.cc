@@ -0,0 +1,16 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include "umdsst/ClimStats/ClimStats.h"
+
+#include "oops/runs/Run.h"
+
+int main(int argc,  char ** argv) {
+  oops::Run run(argc, argv);
+  umdsst::ClimStats climstats;
+  return run.execute(climstats);
+}
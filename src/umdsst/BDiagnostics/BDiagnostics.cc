@@ -0,0 +1,130 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "umdsst/BDiagnostics/BDiagnostics.h"
+#include "umdsst/Covariance/Covariance.h"
+#include "umdsst/Fields/Fields.h"
+#include "umdsst/Geometry/Geometry.h"
+#include "umdsst/Increment/Increment.h"
+#include "umdsst/State/State.h"
+#include "umdsst/Utils/Gradient.h"
+
+#include "eckit/config/Configuration.h"
+#include "eckit/config/LocalConfiguration.h"
+#include "eckit/mpi/Comm.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
+
+#include "oops/base/Variables.h"
+#include "oops/util/abor1_cpp.h"
+#include "oops/util/Logger.h"
+#include "oops/util/missingValues.h"
+
+using atlas::array::make_view;
+
+namespace umdsst {
+
+// ----------------------------------------------------------------------------
+
+  int BDiagnostics::execute(const eckit::Configuration & fullConfig) const {
+    const Geometry geom(eckit::LocalConfiguration(fullConfig, "geometry"),
+                        getComm());
+    const State bkg(geom, eckit::LocalConfiguration(fullConfig, "background"));
+    const oops::Variables vars(fullConfig, "analysis variables");
+    const std::string sst = "sea_surface_temperature";
+    if (!vars.has(sst))
+      util::abor1_cpp("BDiagnostics::execute(), sea_surface_temperature "
+                      "must be an analysis variable", __FILE__, __LINE__);
+    const Covariance cov(geom, vars,
+                         eckit::LocalConfiguration(fullConfig,
+                                                   "background error"),
+                         bkg, bkg);
+
+    const int samples = fullConfig.getInt("samples", 40);
+    const int batch = std::max(fullConfig.getInt("batch size", 10), 1);
+    const size_t seed = fullConfig.getInt("seed", 1);
+    if (samples < 2)
+      util::abor1_cpp("BDiagnostics::execute(), at least 2 samples needed",
+                      __FILE__, __LINE__);
+
+    // the ocean points
+    const size_t npts = geom.atlasFunctionSpace()->size();
+    std::vector<int> ocean(npts, 1);
+    if (geom.atlasFieldSet()->has_field("gmask")) {
+      const int * gmask = make_view<int, 2>(
+        geom.atlasFieldSet()->field("gmask")).data();
+      for (size_t k = 0; k < npts; k++) ocean[k] = gmask[k] != 0;
+    }
+
+    // sums of x^2 and |grad x|^2 over the samples
+    std::vector<double> sumX2(npts, 0.0), sumG2(npts, 0.0);
+    std::vector<double> gx, gy;
+    for (int first = 0; first < samples; first += batch) {
+      const int n = std::min(batch, samples - first);
+      std::vector<Increment> dx(n, Increment(geom, vars, bkg.validTime()));
+      cov.randomize(dx, first, seed);
+      for (int m = 0; m < n; m++) {
+        const double * x = dx[m].fieldData(sst);
+        horizontalGradient(geom, x, ocean, gx, gy);
+        for (size_t k = 0; k < npts; k++) {
+          if (!ocean[k]) continue;
+          sumX2[k] += x[k]*x[k];
+          sumG2[k] += gx[k]*gx[k] + gy[k]*gy[k];
+        }
+      }
+      oops::Log::info() << "BDiagnostics: " << first + n << " of " << samples
+                        << " samples" << std::endl;
+    }
+
+    // the mean variance over the ocean
+    double global[2] = {0.0, 0.0};
+    for (size_t k = 0; k < npts; k++) {
+      if (!ocean[k]) continue;
+      global[0] += sumX2[k] / samples;
+      global[1] += 1.0;
+    }
+    getComm().allReduceInPlace(global, 2, eckit::mpi::Operation::SUM);
+    oops::Log::test() << "BDiagnostics: mean variance "
+                      << (global[1] > 0.0 ? global[0] / global[1] : 0.0)
+                      << std::endl;
+
+    // output
+    Fields out(geom, oops::Variables(std::vector<std::string>{sst}),
+               bkg.validTime());
+    double * y = make_view<double, 2>(
+      out.atlasFieldSet()->field(sst)).data();
+    const double missing = util::missingValue(missing);
+    eckit::LocalConfiguration outConf;
+    fullConfig.get("output", outConf);
+
+    if (outConf.has("standard deviation")) {
+      for (size_t k = 0; k < npts; k++)
+        y[k] = ocean[k] ? std::sqrt(sumX2[k] / samples) : missing;
+      out.write(eckit::LocalConfiguration(outConf, "standard deviation"));
+    }
+
+    if (outConf.has("correlation length")) {
+      // the variance of the gradient has one degree of freedom for each of
+      // its 2 components, hence the factor 2
+      for (size_t k = 0; k < npts; k++)
+        y[k] = ocean[k] && sumG2[k] > 0.0 ?
+               std::sqrt(2.0 * sumX2[k] / sumG2[k]) : missing;
+      out.write(eckit::LocalConfiguration(outConf, "correlation length"));
+    }
+
+    return 0;
+  }
+
+// ----------------------------------------------------------------------------
+
+}  // namespace umdsst
@@ -0,0 +1,50 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_BDIAGNOSTICS_BDIAGNOSTICS_H_
+#define UMDSST_BDIAGNOSTICS_BDIAGNOSTICS_H_
+
+#include <string>
+
+#include "oops/mpi/mpi.h"
+#include "oops/runs/Application.h"
+
+// forward declarations
+namespace eckit {
+  class Configuration;
+}
+
+// ----------------------------------------------------------------------------
+
+namespace umdsst {
+
+  // The variances and length scales of the configured "background error",
+  // estimated from random samples B^1/2 xi. The samples are drawn in
+  // batches of "batch size", each batch being one application of the
+  // batched Covariance::randomize, and only running sums are kept:
+  //  - "standard deviation": sqrt(mean(x^2)), the samples have a zero mean
+  //  - "correlation length": L^2 = 2 var(x) / var(grad x), the length of
+  //    the gaussian correlation with the same variance of the gradient
+  // The fields are written with Fields::write (sea_surface_temperature),
+  // in the format read by the "file" options of StdDev and of the
+  // "correlation lengths". The sampling error of the variances is about
+  // sqrt(2 / "samples").
+  class BDiagnostics : public oops::Application {
+   public:
+    explicit BDiagnostics(const eckit::mpi::Comm & comm = oops::mpi::world())
+      : Application(comm) {}
+    virtual ~BDiagnostics() {}
+
+    int execute(const eckit::Configuration &) const override;
+
+   private:
+    std::string appname() const override {return "umdsst::BDiagnostics";}
+  };
+
+}  // namespace umdsst
+
+#endif  // UMDSST_BDIAGNOSTICS_BDIAGNOSTICS_H_
@@ -0,0 +1,252 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "umdsst/ClimStats/ClimStats.h"
+#include "umdsst/Fields/Fields.h"
+#include "umdsst/Geometry/Geometry.h"
+#include "umdsst/Utils/Gradient.h"
+
+#include "eckit/config/Configuration.h"
+#include "eckit/config/LocalConfiguration.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
+#include "atlas/option.h"
+
+#include "oops/base/Variables.h"
+#include "oops/util/abor1_cpp.h"
+#include "oops/util/DateTime.h"
+#include "oops/util/Duration.h"
+#include "oops/util/Logger.h"
+#include "oops/util/missingValues.h"
+
+using atlas::array::make_view;
+
+namespace umdsst {
+
+namespace {
+  const char sstName[] = "sea_surface_temperature";
+
+  // running mean and sum of the squared deviations of each point
+  // (Welford, 1962)
+  struct Moments {
+    explicit Moments(const size_t size)
+      : n(size, 0), mean(size, 0.0), m2(size, 0.0) {}
+    void add(const size_t k, const double x) {
+      n[k]++;
+      const double d = x - mean[k];
+      mean[k] += d / n[k];
+      m2[k] += d * (x - mean[k]);
+    }
+    double variance(const size_t k) const {
+      return n[k] > 1 ? m2[k] / (n[k] - 1) : 0.0;
+    }
+    std::vector<int> n;
+    std::vector<double> mean, m2;
+  };
+
+  // the same for pairs, with the sum of the products of the deviations
+  struct CoMoments {
+    explicit CoMoments(const size_t size) : a(size), b(size), c(size, 0.0) {}
+    void add(const size_t k, const double xa, const double xb) {
+      const double da = xa - a.mean[k];
+      a.add(k, xa);
+      b.add(k, xb);
+      c[k] += da * (xb - b.mean[k]);
+    }
+    double correlation(const size_t k) const {
+      const double den = std::sqrt(a.m2[k] * b.m2[k]);
+      return den > 0.0 ? c[k] / den : 0.0;
+    }
+    Moments a, b;
+    std::vector<double> c;
+  };
+
+  std::string replaceAll(std::string str, const std::string & from,
+                         const std::string & to) {
+    for (size_t pos = str.find(from); pos != std::string::npos;
+         pos = str.find(from, pos + to.size()))
+      str.replace(pos, from.size(), to);
+    return str;
+  }
+}  // namespace
+
+// ----------------------------------------------------------------------------
+
+  std::vector<eckit::LocalConfiguration> ClimStats::fileList(
+    const eckit::Configuration & conf) const {
+    std::vector<eckit::LocalConfiguration> files;
+    if (conf.has("files")) {
+      files = conf.getSubConfigurations("files");
+    } else if (conf.has("file template")) {
+      // %yyyy%, %mm%, %dd% and %hh% of each date from "first" to "last"
+      const eckit::LocalConfiguration tmpl(conf, "file template");
+      const std::string filename = tmpl.getString("filename");
+      const util::DateTime last(tmpl.getString("last"));
+      const util::Duration step(tmpl.getString("step", "P1D"));
+      for (util::DateTime date(tmpl.getString("first")); date <= last;
+           date += step) {
+        // YYYY-MM-DDThh:mm:ssZ
+        const std::string str = date.toString();
+        std::string name = replaceAll(filename, "%yyyy%", str.substr(0, 4));
+        name = replaceAll(name, "%mm%", str.substr(5, 2));
+        name = replaceAll(name, "%dd%", str.substr(8, 2));
+        name = replaceAll(name, "%hh%", str.substr(11, 2));
+        eckit::LocalConfiguration file;
+        file.set("filename", name);
+        files.push_back(file);
+      }
+    } else {
+      util::abor1_cpp("ClimStats::fileList(), \"files\" or \"file template\" "
+                      "required", __FILE__, __LINE__);
+    }
+
+    // the kelvin setting applies to all the files that do not have their own
+    const bool kelvin = conf.getBool("kelvin", false);
+    for (eckit::LocalConfiguration & file : files)
+      if (!file.has("kelvin")) file.set("kelvin", kelvin);
+    return files;
+  }
+
+// ----------------------------------------------------------------------------
+
+  int ClimStats::execute(const eckit::Configuration & fullConfig) const {
+    const Geometry geom(eckit::LocalConfiguration(fullConfig, "geometry"),
+                        getComm());
+    const std::vector<eckit::LocalConfiguration> files = fileList(fullConfig);
+    const std::vector<int> lags = fullConfig.getIntVector("lags",
+                                                          std::vector<int>());
+    const int maxLag = lags.empty() ? 0 :
+                       *std::max_element(lags.begin(), lags.end());
+    if (!lags.empty() && *std::min_element(lags.begin(), lags.end()) < 1)
+      util::abor1_cpp("ClimStats::execute(), \"lags\" must be positive",
+                      __FILE__, __LINE__);
+    const size_t nfiles = files.size();
+    oops::Log::info() << "ClimStats: " << nfiles << " files" << std::endl;
+
+    // the current file and the ones kept for the lags
+    const oops::Variables vars(std::vector<std::string>{sstName});
+    std::vector<Fields> ring;
+    for (int l = 0; l <= maxLag; l++)
+      ring.push_back(Fields(geom, vars, util::DateTime()));
+    const size_t npts = ring[0].atlasFieldSet()->field(sstName).size();
+
+    Moments moments(npts), gradX(npts), gradY(npts);
+    std::vector<CoMoments> lagMoments(lags.size(), CoMoments(npts));
+    std::vector<std::vector<int>> valid(maxLag+1, std::vector<int>(npts));
+    std::vector<double> gx, gy;
+
+    // two global fields on the root PE, one being read while the other one
+    // is scattered
+    const Fields reader(geom, vars, util::DateTime());
+    atlas::Field global[2];
+    for (int b = 0; b < 2; b++)
+      global[b] = geom.atlasFunctionSpace()->createField<double>(
+        atlas::option::levels(1) | atlas::option::global());
+    auto readFile = [&files, &reader, &global](const size_t n) {
+      reader.readGlobal(files[n], global[n % 2]);
+    };
+
+    const double missing = util::missingValue(missing);
+    const bool hasMask = geom.atlasFieldSet()->has_field("gmask");
+    std::future<void> next;
+    if (nfiles > 0) next = std::async(std::launch::async, readFile, 0);
+    for (size_t n = 0; n < nfiles; n++) {
+      next.get();
+      if (n+1 < nfiles) next = std::async(std::launch::async, readFile, n+1);
+
+      const size_t cur = n % ring.size();
+      ring[cur].fromGlobal(global[n % 2]);
+      const double * x = ring[cur].fieldData(sstName);
+      oops::Log::info() << "ClimStats: " << files[n].getString("filename")
+                        << std::endl;
+
+      // the points where the SST is given
+      std::vector<int> & ok = valid[cur];
+      const int * gmask = hasMask ? make_view<int, 2>(
+        geom.atlasFieldSet()->field("gmask")).data() : nullptr;
+      for (size_t k = 0; k < npts; k++)
+        ok[k] = x[k] != missing && (gmask == nullptr || gmask[k] != 0);
+
+      horizontalGradient(geom, x, ok, gx, gy);
+      for (size_t k = 0; k < npts; k++) {
+        if (!ok[k]) continue;
+        moments.add(k, x[k]);
+        gradX.add(k, gx[k]);
+        gradY.add(k, gy[k]);
+      }
+
+      for (size_t l = 0; l < lags.size(); l++) {
+        if (n < static_cast<size_t>(lags[l])) continue;
+        const size_t prev = (n - lags[l]) % ring.size();
+        const double * xp = ring[prev].fieldData(sstName);
+        for (size_t k = 0; k < npts; k++)
+          if (ok[k] && valid[prev][k])
+            lagMoments[l].add(k, xp[k], x[k]);
+      }
+    }
+
+    // output, missing where there are not enough samples
+    Fields out(geom, vars, util::DateTime());
+    double * y = make_view<double, 2>(
+      out.atlasFieldSet()->field(sstName)).data();
+    eckit::LocalConfiguration outConf;
+    fullConfig.get("output", outConf);
+
+    if (outConf.has("mean")) {
+      for (size_t k = 0; k < npts; k++)
+        y[k] = moments.n[k] > 0 ? moments.mean[k] : missing;
+      out.write(eckit::LocalConfiguration(outConf, "mean"));
+      oops::Log::test() << "ClimStats: mean: " << out << std::endl;
+    }
+
+    if (outConf.has("standard deviation")) {
+      for (size_t k = 0; k < npts; k++)
+        y[k] = moments.n[k] > 1 ? std::sqrt(moments.variance(k)) : missing;
+      out.write(eckit::LocalConfiguration(outConf, "standard deviation"));
+      oops::Log::test() << "ClimStats: standard deviation: " << out
+                        << std::endl;
+    }
+
+    if (outConf.has("correlation length")) {
+      for (size_t k = 0; k < npts; k++) {
+        const double vg = gradX.variance(k) + gradY.variance(k);
+        y[k] = moments.n[k] > 1 && vg > 0.0 ?
+               std::sqrt(2.0 * moments.variance(k) / vg) : missing;
+      }
+      out.write(eckit::LocalConfiguration(outConf, "correlation length"));
+      oops::Log::test() << "ClimStats: correlation length: " << out
+                        << std::endl;
+    }
+
+    if (outConf.has("lag correlation")) {
+      const eckit::LocalConfiguration lagConf(outConf, "lag correlation");
+      for (size_t l = 0; l < lags.size(); l++) {
+        for (size_t k = 0; k < npts; k++)
+          y[k] = lagMoments[l].a.n[k] > 1 ?
+                 lagMoments[l].correlation(k) : missing;
+        eckit::LocalConfiguration conf(lagConf);
+        conf.set("filename", replaceAll(lagConf.getString("filename"),
+                                        "%lag%", std::to_string(lags[l])));
+        out.write(conf);
+        oops::Log::test() << "ClimStats: lag " << lags[l] << " correlation: "
+                          << out << std::endl;
+      }
+    }
+
+    return 0;
+  }
+
+// ----------------------------------------------------------------------------
+
+}  // namespace umdsst
@@ -0,0 +1,63 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_CLIMSTATS_CLIMSTATS_H_
+#define UMDSST_CLIMSTATS_CLIMSTATS_H_
+
+#include <string>
+#include <vector>
+
+#include "oops/mpi/mpi.h"
+#include "oops/runs/Application.h"
+
+// forward declarations
+namespace eckit {
+  class Configuration;
+  class LocalConfiguration;
+}
+
+// ----------------------------------------------------------------------------
+
+namespace umdsst {
+
+  // Point-wise statistics of a long series of SST files, to estimate the
+  // parameters of B. The files are streamed one at a time through
+  // Fields::read, the next one being read on a separate thread while the
+  // current one is processed, and only running (Welford) accumulators are
+  // kept, plus the last "lags" files for the lag covariances.
+  //
+  // The outputs are written with Fields::write, so they can be used
+  // directly as the "file" of the StdDev variable change and of the
+  // "correlation lengths":
+  //  - "mean" and "standard deviation"
+  //  - "correlation length": the length of the gaussian correlation with
+  //    the same variance of the gradient, L^2 = 2 var(x) / var(grad x)
+  //    (Belo Pereira and Berre, 2006)
+  //  - "lag correlation": the correlation between files "lag" apart, one
+  //    file per lag ("%lag%" in the file name)
+  //
+  // The statistics are of the fields as given, so the files should be
+  // anomalies (or differences) for the seasonal cycle to be left out.
+  class ClimStats : public oops::Application {
+   public:
+    explicit ClimStats(const eckit::mpi::Comm & comm = oops::mpi::world())
+      : Application(comm) {}
+    virtual ~ClimStats() {}
+
+    int execute(const eckit::Configuration &) const override;
+
+   private:
+    std::string appname() const override {return "umdsst::ClimStats";}
+
+    // the "files" list, or the "file template" expanded over its dates
+    std::vector<eckit::LocalConfiguration> fileList(
+      const eckit::Configuration &) const;
+  };
+
+}  // namespace umdsst
+
+#endif  // UMDSST_CLIMSTATS_CLIMSTATS_H_
@@ -0,0 +1,277 @@
+/*
+ * (C) Copyright 2019-2021 UCAR
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "umdsst/Covariance/BumpCorrelation.h"
+#include "umdsst/Geometry/Geometry.h"
+#include "umdsst/Utils/Hash.h"
+
+#include "eckit/config/Configuration.h"
+#include "eckit/config/LocalConfiguration.h"
+#include "eckit/filesystem/PathName.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
+#include "atlas/option.h"
+
+#include "oops/base/Variables.h"
+#include "oops/util/Logger.h"
+#include "oops/util/Timer.h"
+#include "oops/util/missingValues.h"
+
+#include "saber/bump/type_bump.h"
+
+using atlas::array::make_view;
+
+namespace umdsst {
+
+// ----------------------------------------------------------------------------
+
+  BumpCorrelation::BumpCorrelation(const Geometry & geom,
+                                   const oops::Variables & vars,
+                                   const eckit::Configuration & conf) {
+    // user generated parameter fields for BUMP, the same for each variable
+    // --------------------------------------------
+    atlas::FieldSet param_fieldSet;
+    for (size_t v = 0; v < vars.size(); v++)
+      param_fieldSet.add(geom.atlasFunctionSpace()->createField<double>(
+        atlas::option::levels(1) | atlas::option::name(vars[v])));
+    atlas::Field param_field = param_fieldSet[0];
+    auto param_view = atlas::array::make_view<double, 2>(param_field);
+
+    // horizontal correlation lengths
+    const bool hasCorrLengths = conf.has("correlation lengths");
+    if (hasCorrLengths) {
+      auto lengths = atlas::array::make_view<double, 2>(
+        correlationLengths(geom, conf));
+
+      // note: BUMP expects the length as a Gaspari-Cohn cutoff length,
+      //   but we probably think of it as a Gaussian 1 sigma, so convert.
+      for ( int i = 0; i < param_field.size(); i++ ) {
+        param_view(i, 0) = lengths(i, 0) * 3.57;  // gaussian to GC factor
+      }
+      for (int v = 1; v < param_fieldSet.size(); v++) {
+        auto view = atlas::array::make_view<double, 2>(param_fieldSet[v]);
+        for ( int i = 0; i < param_field.size(); i++ )
+          view(i, 0) = param_view(i, 0);
+      }
+    }
+
+    // setup BUMP
+    // --------------------------------------------
+    eckit::LocalConfiguration bumpConf;
+    conf.get("bump", bumpConf);
+    const double msvalr = util::missingValue(msvalr);
+    bumpConf.set("msvalr", msvalr);
+
+    // If a NICAS cache is used, load the NICAS data from the cache if it was
+    // already computed for identical inputs, otherwise compute it and store
+    // it in the cache.
+    std::string cacheDir;
+    bool cacheHit = false;
+    if (conf.has("nicas cache")) {
+      uint64_t key = nicasKey(geom, bumpConf, param_field, hasCorrLengths);
+      for (size_t v = 0; v < vars.size(); v++)
+        key = hashString(vars[v], key);
+      cacheDir = conf.getString("nicas cache.directory") + "/" + hashHex(key);
+      cacheHit = loadNicasCache(geom, cacheDir, bumpConf);
+    }
+
+    eckit::LocalConfiguration gridConf;
+    std::string prefix;
+    bumpConf.get("prefix", prefix);
+    gridConf.set("prefix", prefix + "_00");
+    gridConf.set("variables", vars.variables());
+    gridConf.set("nv", vars.size());
+    gridConf.set("nl", 1);
+
+    oops::Log::info() << "Configuration: " << bumpConf << std::endl;
+    oops::Log::info() << "Grid " << 0 << ": " << gridConf << std::endl;
+
+    saber::bump_create_f90(keyBump_, &geom.getComm(),
+                    geom.atlasFunctionSpace()->get(),
+                    geom.atlasFieldSet()->get(),
+                    bumpConf, gridConf);
+
+    // pass user generated fields to BUMP
+    // --------------------------------------------
+    if (hasCorrLengths) {
+      std::string param_name = "cor_rh";
+      saber::bump_set_parameter_f90(keyBump_, param_name.size(),
+                                    param_name.c_str(), param_fieldSet.get());
+
+      // vertical lengths (leave at 1.0, because we have no vertical)
+      param_name = "cor_rv";
+      for (int v = 0; v < param_fieldSet.size(); v++)
+        atlas::array::make_view<double, 2>(param_fieldSet[v]).assign(1.0);
+      saber::bump_set_parameter_f90(keyBump_, param_name.size(),
+                                    param_name.c_str(), param_fieldSet.get());
+    }
+
+    // Calculate static B and cleanup
+    // --------------------------------------------
+    saber::bump_run_drivers_f90(keyBump_);
+    saber::bump_partial_dealloc_f90(keyBump_);
+
+    // mark the newly computed NICAS data as complete, only after this is the
+    // cache entry used by later runs
+    if (!cacheDir.empty() && !cacheHit) {
+      geom.getComm().barrier();
+      if (geom.getComm().rank() == 0) {
+        std::ofstream marker(cacheDir + "/nicas.done");
+        marker << bumpConf << std::endl;
+      }
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  uint64_t BumpCorrelation::nicasKey(
+    const Geometry & geom, const eckit::LocalConfiguration & bumpConf,
+    const atlas::Field & corrLengths, const bool hasCorrLengths) const {
+    // The key covers everything the NICAS data depends on: the grid and its
+    // decomposition, the land mask, the correlation lengths and the BUMP
+    // parameters. The field hashes are sums over the points, so they are
+    // independent of how the points are distributed.
+    const atlas::functionspace::StructuredColumns & fs =
+      *geom.atlasFunctionSpace();
+    auto gidx = atlas::array::make_view<atlas::gidx_t, 1>(fs.global_index());
+
+    uint64_t maskHash = 0, corrHash = 0;
+    if (geom.atlasFieldSet()->has_field("gmask")) {
+      auto mask = atlas::array::make_view<int, 2>(
+        geom.atlasFieldSet()->field("gmask"));
+      for (int i = 0; i < fs.size(); i++)
+        maskHash += hashMix(gidx(i), static_cast<uint64_t>(mask(i, 0)));
+    }
+    if (hasCorrLengths) {
+      auto corr = atlas::array::make_view<double, 2>(corrLengths);
+      for (int i = 0; i < fs.size(); i++) {
+        uint64_t bits;
+        const double val = corr(i, 0);
+        std::memcpy(&bits, &val, sizeof(bits));
+        corrHash += hashMix(gidx(i), bits);
+      }
+    }
+    geom.getComm().allReduceInPlace(maskHash, eckit::mpi::Operation::SUM);
+    geom.getComm().allReduceInPlace(corrHash, eckit::mpi::Operation::SUM);
+
+    // the BUMP parameters, ignoring the ones that are set by the cache itself
+    eckit::LocalConfiguration conf(bumpConf);
+    conf.set("datadir", "");
+    conf.set("new_nicas", 0);
+    conf.set("load_nicas", 0);
+    conf.set("write_nicas", 0);
+    std::ostringstream confStr;
+    confStr << conf;
+
+    uint64_t key = hashString(fs.grid().uid());
+    key = hashString(std::to_string(geom.getComm().size()), key);
+    key = hashString(confStr.str(), key);
+    key = hashMix(key, maskHash);
+    key = hashMix(key, corrHash);
+    return key;
+  }
+
+// ----------------------------------------------------------------------------
+
+  bool BumpCorrelation::loadNicasCache(
+    const Geometry & geom, const std::string & cacheDir,
+    eckit::LocalConfiguration & bumpConf) const {
+    // check for a complete cache entry on the root PE only, so that all PEs
+    // agree even on a file system that is slow to show new files
+    int hit = 0;
+    if (geom.getComm().rank() == 0) {
+      hit = eckit::PathName(cacheDir + "/nicas.done").exists() ? 1 : 0;
+      if (!hit)
+        eckit::PathName(cacheDir).mkdir();
+    }
+    geom.getComm().broadcast(hit, 0);
+
+    bumpConf.set("datadir", cacheDir);
+    bumpConf.set("new_nicas", hit ? 0 : 1);
+    bumpConf.set("write_nicas", hit ? 0 : 1);
+    bumpConf.set("load_nicas", hit ? 1 : 0);
+
+    oops::Log::info() << "BumpCorrelation: NICAS cache "
+                      << (hit ? "hit" : "miss") << ", " << cacheDir
+                      << std::endl;
+    return hit == 1;
+  }
+
+// ----------------------------------------------------------------------------
+
+  void BumpCorrelation::multiply(atlas::FieldSet & fset) const {
+    util::Timer timer("umdsst::BumpCorrelation", "multiply");
+    applyLevels(fset, saber::bump_apply_nicas_f90);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void BumpCorrelation::randomize(atlas::FieldSet & fset) const {
+    util::Timer timer("umdsst::BumpCorrelation", "randomize");
+    applyLevels(fset, saber::bump_randomize_f90);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void BumpCorrelation::applyLevels(
+    atlas::FieldSet & fset,
+    void (*apply)(const int &, atlas::field::FieldSetImpl *)) const {
+    bool singleLevel = true;
+    for (int f = 0; f < fset.size(); f++)
+      singleLevel = singleLevel && fset[f].levels() == 1;
+    if (singleLevel) {
+      apply(keyBump_, fset.get());
+      return;
+    }
+
+    // NICAS is set up for single level fields, so apply it to each level
+    // (e.g. the members of a batched multiply) in turn
+    atlas::FieldSet level;
+    std::vector<int> nlev(fset.size());
+    for (int f = 0; f < fset.size(); f++) {
+      nlev[f] = fset[f].levels();
+      level.add(fset[f].functionspace().createField<double>(
+        atlas::option::levels(1) | atlas::option::name(fset[f].name())));
+    }
+    const int npts = fset[0].shape(0);
+    const int maxLevels = *std::max_element(nlev.begin(), nlev.end());
+    for (int l = 0; l < maxLevels; l++) {
+      for (int f = 0; f < fset.size(); f++) {
+        const double * src = make_view<double, 2>(fset[f]).data();
+        double * dst = make_view<double, 2>(level[f]).data();
+        for (int k = 0; k < npts; k++)
+          dst[k] = l < nlev[f] ? src[k*nlev[f]+l] : 0.0;
+      }
+      apply(keyBump_, level.get());
+      for (int f = 0; f < fset.size(); f++) {
+        if (l >= nlev[f]) continue;
+        double * dst = make_view<double, 2>(fset[f]).data();
+        const double * src = make_view<double, 2>(level[f]).data();
+        for (int k = 0; k < npts; k++)
+          dst[k*nlev[f]+l] = src[k];
+      }
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void BumpCorrelation::print(std::ostream & os) const {
+    os << "BumpCorrelation: NICAS" << std::endl;
+  }
+
+// ----------------------------------------------------------------------------
+
+}  // namespace umdsst
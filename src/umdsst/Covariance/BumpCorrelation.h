@@ -0,0 +1,70 @@
+/*
+ * (C) Copyright 2019-2021 UCAR
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_COVARIANCE_BUMPCORRELATION_H_
+#define UMDSST_COVARIANCE_BUMPCORRELATION_H_
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "umdsst/Covariance/CorrelationBase.h"
+
+// forward declarations
+namespace atlas {
+namespace field {
+  class FieldSetImpl;
+}
+}
+namespace eckit {
+  class LocalConfiguration;
+}
+namespace oops {
+  class Variables;
+}
+
+// ----------------------------------------------------------------------------
+
+namespace umdsst {
+
+  // Correlation operator given by the NICAS component of SABER's BUMP.
+  // NICAS is set up for single level fields without vertical correlation,
+  // so multiply applies it to the levels of a multi-level field (e.g. the
+  // members of a batch) one at a time: a batch of n members costs n NICAS
+  // applications, as many as n separate calls.
+  class BumpCorrelation : public CorrelationBase {
+   public:
+    BumpCorrelation(const Geometry &, const oops::Variables &,
+                    const eckit::Configuration &);
+    ~BumpCorrelation() {}
+
+    void multiply(atlas::FieldSet &) const override;
+
+    // samples of NICAS drawn by BUMP, from its own random numbers, one per
+    // level of the fields
+    bool hasRandomize() const override { return true; }
+    void randomize(atlas::FieldSet &) const override;
+
+   private:
+    void print(std::ostream &) const override;
+
+    // a NICAS operation of BUMP on each level of the fields in turn
+    void applyLevels(atlas::FieldSet &,
+                     void (*)(const int &, atlas::field::FieldSetImpl *)) const;
+
+    // persistent NICAS cache
+    uint64_t nicasKey(const Geometry &, const eckit::LocalConfiguration &,
+                      const atlas::Field &, const bool) const;
+    bool loadNicasCache(const Geometry &, const std::string &,
+                        eckit::LocalConfiguration &) const;
+
+    int keyBump_ = 0;
+  };
+
+}  // namespace umdsst
+
+#endif  // UMDSST_COVARIANCE_BUMPCORRELATION_H_
@@ -0,0 +1,170 @@
+/*
+ * (C) Copyright 2019-2021 UCAR
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "umdsst/Covariance/BumpCorrelation.h"
+#include "umdsst/Covariance/CorrelationBase.h"
+#include "umdsst/Covariance/Diffusion.h"
+#include "umdsst/Covariance/RecursiveFilter.h"
+#include "umdsst/Fields/Fields.h"
+#include "umdsst/Geometry/Geometry.h"
+
+#include "eckit/config/Configuration.h"
+#include "eckit/config/LocalConfiguration.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
+#include "atlas/option.h"
+
+#include "oops/base/Variables.h"
+#include "oops/util/abor1_cpp.h"
+#include "oops/util/DateTime.h"
+#include "oops/util/missingValues.h"
+
+namespace umdsst {
+
+// ----------------------------------------------------------------------------
+
+  CorrelationBase * CorrelationBase::create(const Geometry & geom,
+                                            const oops::Variables & vars,
+                                            const eckit::Configuration & conf) {
+    const std::string model = conf.getString("correlation model", "bump");
+    if (model == "bump") {
+      return new BumpCorrelation(geom, vars, conf);
+    } else if (model == "diffusion") {
+      return new Diffusion(geom, conf);
+    } else if (model == "recursive filter") {
+      return new RecursiveFilter(geom, conf);
+    }
+    util::abor1_cpp("CorrelationBase::create(), unknown correlation model \""
+                    + model + "\"", __FILE__, __LINE__);
+    return nullptr;
+  }
+
+// ----------------------------------------------------------------------------
+
+  void CorrelationBase::inverseMultiply(atlas::FieldSet &) const {
+    util::abor1_cpp("CorrelationBase::inverseMultiply() not available for "
+                    "this correlation model", __FILE__, __LINE__);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void CorrelationBase::sqrtMultiply(atlas::FieldSet &) const {
+    util::abor1_cpp("CorrelationBase::sqrtMultiply() not available for "
+                    "this correlation model", __FILE__, __LINE__);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void CorrelationBase::randomize(atlas::FieldSet & fset) const {
+    sqrtMultiply(fset);
+  }
+
+// ----------------------------------------------------------------------------
+
+  int CorrelationBase::packLevels(const atlas::FieldSet & fset,
+                                  std::vector<double> & x) {
+    int nlev = 0;
+    for (int f = 0; f < fset.size(); f++)
+      nlev += fset[f].levels();
+    const size_t npts = fset.size() > 0 ? fset[0].shape(0) : 0;
+    x.resize(npts*nlev);
+
+    int l0 = 0;
+    for (int f = 0; f < fset.size(); f++) {
+      const int fl = fset[f].levels();
+      const double * data = atlas::array::make_view<double, 2>(fset[f]).data();
+      for (size_t k = 0; k < npts; k++)
+        std::copy_n(data + k*fl, fl, &x[k*nlev + l0]);
+      l0 += fl;
+    }
+    return nlev;
+  }
+
+// ----------------------------------------------------------------------------
+
+  void CorrelationBase::unpackLevels(const std::vector<double> & x,
+                                     atlas::FieldSet & fset) {
+    int nlev = 0;
+    for (int f = 0; f < fset.size(); f++)
+      nlev += fset[f].levels();
+    const size_t npts = fset.size() > 0 ? fset[0].shape(0) : 0;
+
+    int l0 = 0;
+    for (int f = 0; f < fset.size(); f++) {
+      const int fl = fset[f].levels();
+      double * data = atlas::array::make_view<double, 2>(fset[f]).data();
+      for (size_t k = 0; k < npts; k++)
+        std::copy_n(&x[k*nlev + l0], fl, data + k*fl);
+      l0 += fl;
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  atlas::Field CorrelationBase::correlationLengths(
+    const Geometry & geom, const eckit::Configuration & conf) {
+    atlas::Field lengths = geom.atlasFunctionSpace()->createField<double>(
+      atlas::option::levels(1) | atlas::option::name("cor_rh"));
+    auto lengths_view = atlas::array::make_view<double, 2>(lengths);
+
+    eckit::LocalConfiguration corrConf;
+    conf.get("correlation lengths", corrConf);
+
+    // rh is calculated as follows :
+    // 1) rh = "base value" + rossby_radius * "rossby mult"
+    //    + the lengths read from "file" (e.g. written by umdsst_climstats.x,
+    //    0 where they are missing)
+    // 2) minimum value of "min grid mult" * grid_size is imposed
+    // 3) min/max are imposed based on "min value" and "max value"
+    double baseValue = corrConf.getDouble("base value", 0.0);
+    double rossbyMult = corrConf.getDouble("rossby mult", 0.0);
+    double minGridMult = corrConf.getDouble("min grid mult", 0.0);
+    double minValue = corrConf.getDouble("min value", 0.0);
+    double maxValue = corrConf.getDouble("max value",
+                                     std::numeric_limits<double>::max());
+
+    auto area = atlas::array::make_view<double, 2>(
+       geom.atlasFieldSet()->field("area"));
+
+    lengths_view.assign(baseValue);
+    if (rossbyMult != 0.0) {
+      auto rossbyRadius = atlas::array::make_view<double, 2>(
+        geom.atlasFieldSet()->field("rossby_radius"));
+      for ( int i = 0; i < lengths.size(); i++ )
+        lengths_view(i, 0) += rossbyMult * rossbyRadius(i, 0);
+    }
+    if (corrConf.has("file")) {
+      eckit::LocalConfiguration fileConf(corrConf, "file");
+      fileConf.set("kelvin", false);
+      const std::string var = "sea_surface_temperature";
+      Fields fileLengths(geom, oops::Variables(std::vector<std::string>{var}),
+                         util::DateTime());
+      fileLengths.read(fileConf);
+      const double * x = fileLengths.fieldData(var);
+      const double missing = util::missingValue(missing);
+      for ( int i = 0; i < lengths.size(); i++ )
+        if (x[i] != missing) lengths_view(i, 0) += x[i];
+    }
+    for ( int i = 0; i < lengths.size(); i++ ) {
+      lengths_view(i, 0) = std::max(lengths_view(i, 0),
+                                    minGridMult*sqrt(area(i, 0)));
+      lengths_view(i, 0) = std::max(lengths_view(i, 0), minValue);
+      lengths_view(i, 0) = std::min(lengths_view(i, 0), maxValue);
+    }
+
+    return lengths;
+  }
+
+// ----------------------------------------------------------------------------
+
+}  // namespace umdsst
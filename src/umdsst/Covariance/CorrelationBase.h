@@ -0,0 +1,78 @@
+/*
+ * (C) Copyright 2019-2021 UCAR
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_COVARIANCE_CORRELATIONBASE_H_
+#define UMDSST_COVARIANCE_CORRELATIONBASE_H_
+
+#include <vector>
+
+#include "oops/util/Printable.h"
+
+// forward declarations
+namespace atlas {
+  class Field;
+  class FieldSet;
+}
+namespace eckit {
+  class Configuration;
+}
+namespace oops {
+  class Variables;
+}
+namespace umdsst {
+  class Geometry;
+}
+
+// ----------------------------------------------------------------------------
+
+namespace umdsst {
+
+  // Base class of the horizontal correlation operators used by Covariance.
+  // All operators act in place on a FieldSet holding one field per variable.
+  // A field can have several levels, each level is treated as an independent
+  // 2D field, and all the levels of all the fields are handled together.
+  class CorrelationBase : public util::Printable {
+   public:
+    virtual ~CorrelationBase() {}
+
+    // the operator chosen by "correlation model" ("bump", the default,
+    // "diffusion" or "recursive filter"), for the given variables
+    static CorrelationBase * create(const Geometry &, const oops::Variables &,
+                                    const eckit::Configuration &);
+
+    // C
+    virtual void multiply(atlas::FieldSet &) const = 0;
+
+    // C^-1, if the operator provides it
+    virtual bool hasInverse() const { return false; }
+    virtual void inverseMultiply(atlas::FieldSet &) const;
+
+    // U, where C = U U^T, if the operator provides it
+    virtual bool hasSqrt() const { return false; }
+    virtual void sqrtMultiply(atlas::FieldSet &) const;
+
+    // a sample U xi of C, in place of the N(0,1) noise xi held by the
+    // fields (sqrtMultiply). An operator without U can still draw samples
+    // from its own noise, ignoring the fields (BUMP).
+    virtual bool hasRandomize() const { return hasSqrt(); }
+    virtual void randomize(atlas::FieldSet &) const;
+
+   protected:
+    // all the levels of all the fields as one point-major array (point k,
+    // level l at k*nlev + l), returns the total number of levels nlev
+    static int packLevels(const atlas::FieldSet &, std::vector<double> &);
+    static void unpackLevels(const std::vector<double> &, atlas::FieldSet &);
+
+    // The horizontal correlation lengths (gaussian 1 sigma, in meters) given
+    // by the "correlation lengths" section of the configuration
+    static atlas::Field correlationLengths(const Geometry &,
+                                           const eckit::Configuration &);
+  };
+
+}  // namespace umdsst
+
+#endif  // UMDSST_COVARIANCE_CORRELATIONBASE_H_
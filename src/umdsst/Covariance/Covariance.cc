@@ -6,25 +6,35 @@
  */
 
 #include <algorithm>
-#include <limits>
+#include <cmath>
 #include <ostream>
+#include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "umdsst/Covariance/CorrelationBase.h"
 #include "umdsst/Covariance/Covariance.h"
+#include "umdsst/Covariance/EnsembleCovariance.h"
 #include "umdsst/Geometry/Geometry.h"
 #include "umdsst/Increment/Increment.h"
+#include "umdsst/LinearVariableChange/StdDev.h"
 #include "umdsst/State/State.h"
+#include "umdsst/Utils/Philox.h"
 
 #include "eckit/config/Configuration.h"
+#include "eckit/config/LocalConfiguration.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
+#include "atlas/option.h"
 
-#include "oops/assimilation/GMRESR.h"
-#include "oops/base/IdentityMatrix.h"
 #include "oops/base/Variables.h"
 #include "oops/util/abor1_cpp.h"
 #include "oops/util/Logger.h"
-#include "oops/util/missingValues.h"
+#include "oops/util/Timer.h"
 
-#include "saber/bump/type_bump.h"
+using atlas::array::make_view;
 
 namespace umdsst {
 
@@ -36,92 +46,110 @@ namespace umdsst {
                          const State & x1, const State & x2) {
     oops::Log::trace() << "umdsst::Covariance::Covariance starting"<< std::endl;
 
-    // setup BUMP
-    // --------------------------------------------
-    eckit::LocalConfiguration bumpConf;
-    conf.get("bump", bumpConf);
-    const double msvalr = util::missingValue(msvalr);
-    bumpConf.set("msvalr", msvalr);
-
-    eckit::LocalConfiguration gridConf;
-    std::string prefix;
-    bumpConf.get("prefix", prefix);
-    gridConf.set("prefix", prefix + "_00");
-    gridConf.set("variables", vars.variables());
-    gridConf.set("nv", vars.size());
-    gridConf.set("nl", 1);
-
-    oops::Log::info() << "Configuration: " << bumpConf << std::endl;
-    oops::Log::info() << "Grid " << 0 << ": " << gridConf << std::endl;
-
-    saber::bump_create_f90(keyBump_, &geom.getComm(),
-                    geom.atlasFunctionSpace()->get(),
-                    geom.atlasFieldSet()->get(),
-                    bumpConf, gridConf);
-
-    // pass user generated fields to BUMP
-    // NOTE: assuming only 1 state variable
-    // --------------------------------------------
-    assert(vars.size() == 1);
-    std::string param_name;
-    atlas::FieldSet param_fieldSet;
-    atlas::Field param_field = geom.atlasFunctionSpace()->createField<double>(
-      atlas::option::levels(1) | atlas::option::name(vars[0]));
-    param_fieldSet.add(param_field);
-    auto param_view = atlas::array::make_view<double, 2>(param_field);
-
-    // horizontal correlation lengths
-    if (conf.has("correlation lengths")) {
-      eckit::LocalConfiguration corrConf;
-      conf.get("correlation lengths", corrConf);
-
-      // rh is calculated as follows :
-      // 1) rh = "base value" + rossby_radius * "rossby mult"
-      // 2) minimum value of "min grid mult" * grid_size is imposed
-      // 3) min/max are imposed based on "min value" and "max value"
-      // 4) converted from a gaussian sigma to Gaspari-Cohn cutoff distance
-      double baseValue = corrConf.getDouble("base value", 0.0);
-      double rossbyMult = corrConf.getDouble("rossby mult", 0.0);
-      double minGridMult = corrConf.getDouble("min grid mult", 0.0);
-      double minValue = corrConf.getDouble("min value", 0.0);
-      double maxValue = corrConf.getDouble("max value",
-                                       std::numeric_limits<double>::max());
-
-      auto rossbyRadius = atlas::array::make_view<double, 2>(
-        geom.atlasFieldSet()->field("rossby_radius"));
-      auto area = atlas::array::make_view<double, 2>(
-         geom.atlasFieldSet()->field("area"));
-
-      param_view.assign(baseValue);
-      for ( int i = 0; i < param_field.size(); i++ ) {
-        param_view(i, 0) += rossbyMult * rossbyRadius(i, 0);
-        param_view(i, 0) = std::max(param_view(i, 0),
-                                    minGridMult*sqrt(area(i, 0)));
-        param_view(i, 0) = std::max(param_view(i, 0), minValue);
-        param_view(i, 0) = std::min(param_view(i, 0), maxValue);
+    // hybrid weights, B = "static weight" Bs + "weight" Be, without the
+    // static part when its weight is 0
+    staticWeight_ = 1.0;
+    ensembleWeight_ = 0.0;
+    randomCount_ = 0;
+    if (conf.has("ensemble")) {
+      const eckit::LocalConfiguration ensConf(conf, "ensemble");
+      ensembleWeight_ = ensConf.getDouble("weight", 0.5);
+      staticWeight_ = ensConf.getDouble("static weight",
+                                        1.0 - ensembleWeight_);
+      ensemble_.reset(new EnsembleCovariance(geom, vars, ensConf));
+      oops::Log::info() << "Covariance: " << *ensemble_ << std::endl;
+    }
+    const std::vector<std::string> staticVars = staticWeight_ > 0.0 ?
+      vars.variables() : std::vector<std::string>();
+
+    // group the variables with the same correlation settings into blocks
+    const std::vector<std::string> blockKeys{"correlation model",
+      "correlation lengths", "bump", "nicas cache", "diffusion",
+      "recursive filter"};
+    std::vector<std::string> blockIds;
+    std::vector<eckit::LocalConfiguration> blockConfs;
+    for (const std::string & var : staticVars) {
+      eckit::LocalConfiguration varConf;
+      if (conf.has("variables")) {
+        eckit::LocalConfiguration allVars(conf, "variables");
+        if (allVars.has(var)) allVars.get(var, varConf);
       }
-
-      // note: BUMP expects the length as a Gaspari-Cohn cutoff length,
-      //   but we probably think of it as a Gaussian 1 sigma, so convert.
-      for ( int i = 0; i < param_field.size(); i++ ) {
-        param_view(i, 0) *= 3.57;  // gaussian to GC factor
+      eckit::LocalConfiguration blockConf;
+      for (const std::string & key : blockKeys) {
+        const eckit::Configuration & src = varConf.has(key) ? varConf : conf;
+        if (!src.has(key)) continue;
+        if (key == "correlation model")
+          blockConf.set(key, src.getString(key));
+        else
+          blockConf.set(key, eckit::LocalConfiguration(src, key));
       }
+      std::ostringstream id;
+      id << blockConf;
+      const size_t b = std::find(blockIds.begin(), blockIds.end(), id.str())
+                       - blockIds.begin();
+      if (b == blockIds.size()) {
+        blockIds.push_back(id.str());
+        blockConfs.push_back(blockConf);
+        blocks_.push_back(Block());
+      }
+      blocks_[b].vars.push_back(var);
+    }
 
-      param_name = "cor_rh";
-      saber::bump_set_parameter_f90(keyBump_, param_name.size(),
-                                    param_name.c_str(), param_fieldSet.get());
+    for (size_t b = 0; b < blocks_.size(); b++) {
+      const eckit::LocalConfiguration & blockConf = blockConfs[b];
+      const oops::Variables blockVars(blocks_[b].vars);
+      CorrelationBase * correlation =
+        CorrelationBase::create(geom, blockVars, blockConf);
+      blocks_[b].correlation.reset(correlation);
+      oops::Log::info() << "Covariance: " << blockVars << ": "
+                        << *correlation << std::endl;
+    }
 
-      // vertical lengths (leave at 1.0, because we have no vertical)
-      param_name = "cor_rv";
-      param_view.assign(1.0);
-      saber::bump_set_parameter_f90(keyBump_, param_name.size(),
-                                    param_name.c_str(), param_fieldSet.get());
+    // balance
+    if (conf.has("balance")) {
+      for (const eckit::LocalConfiguration & balConf :
+           conf.getSubConfigurations("balance")) {
+        Balance bal;
+        bal.var = balConf.getString("variable");
+        bal.from = balConf.getString("from");
+        bal.coef = balConf.getDouble("coefficient");
+        if (!vars.has(bal.var) || !vars.has(bal.from) || bal.var == bal.from)
+          util::abor1_cpp("Covariance::Covariance(), invalid balance from "
+                          + bal.from + " to " + bal.var, __FILE__, __LINE__);
+        balance_.push_back(bal);
+      }
     }
 
-    // Calculate static B and cleanup
-    // --------------------------------------------
-    saber::bump_run_drivers_f90(keyBump_);
-    saber::bump_partial_dealloc_f90(keyBump_);
+    // standard deviation
+    if (conf.has("standard deviation"))
+      stddev_.reset(new StdDev(x1, x2, geom,
+        eckit::LocalConfiguration(conf, "standard deviation")));
+
+    // inverse
+    eckit::LocalConfiguration invConf;
+    conf.get("inverse", invConf);
+    const std::string method = invConf.getString("method", "auto");
+    bool hasInverse = true;
+    for (const Block & block : blocks_)
+      hasInverse = hasInverse && block.correlation->hasInverse();
+    hasInverse = hasInverse && !ensemble_;
+    if (method == "auto") {
+      exactInverse_ = hasInverse;
+    } else if (method == "exact") {
+      if (!hasInverse)
+        util::abor1_cpp("Covariance::Covariance(), the correlation model "
+                        "or the ensemble covariance has no exact inverse",
+                        __FILE__, __LINE__);
+      exactInverse_ = true;
+    } else if (method == "cg") {
+      exactInverse_ = false;
+    } else {
+      util::abor1_cpp("Covariance::Covariance(), unknown inverse method \""
+                      + method + "\"", __FILE__, __LINE__);
+    }
+    inverseTolerance_ = invConf.getDouble("tolerance", 1.0e-3);
+    inverseMaxIter_ = invConf.getInt("max iterations", 10);
+    recycleMax_ = invConf.getInt("recycled vectors", 20);
 
     oops::Log::trace() << "umdsst::Covariance::Covariance done" << std::endl;
   }
@@ -136,29 +164,334 @@ namespace umdsst {
 
   void Covariance::inverseMultiply(const Increment & dxin,
                                    Increment & dxout) const {
-    oops::IdentityMatrix<Increment> Id;
-    dxout.zero();
-    GMRESR(dxout, dxin, *this, Id, 10, 1.0e-3);
+    if (exactInverse_) {
+      dxout = dxin;
+      applyBInverse(*dxout.atlasFieldSet());
+    } else {
+      recycledCG(dxin, dxout);
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Covariance::recycledCG(const Increment & b, Increment & x) const {
+    // Deflated CG (Saad et al., 2000) with W = recycleP_, W^T B W = I:
+    // x0 = W W^T b, and each new direction is made B-conjugate to W, so the
+    // part of the solution in span(W) costs no iterations. The directions
+    // of this solve are then kept for the next ones.
+    const size_t nw = recycleP_.size();
+    Increment r(b);
+    x = b;
+    x.zero();
+    for (size_t i = 0; i < nw; i++) {
+      const double wb = recycleP_[i].dot_product_with(b);
+      x.axpy(wb, recycleP_[i]);
+      r.axpy(-wb, recycleBP_[i]);
+    }
+
+    // p = r - W (BW)^T r
+    Increment p(r);
+    for (size_t i = 0; i < nw; i++)
+      p.axpy(-recycleBP_[i].dot_product_with(r), recycleP_[i]);
+
+    const double bnorm = std::sqrt(b.dot_product_with(b));
+    double rho = r.dot_product_with(r);
+    Increment q(b, false);
+    std::vector<Increment> newP, newBP;
+    int iter = 0;
+    for (; iter < inverseMaxIter_; iter++) {
+      if (bnorm == 0.0 || std::sqrt(rho) <= inverseTolerance_ * bnorm) break;
+      multiply(p, q);
+      const double pq = p.dot_product_with(q);
+      const double alpha = rho / pq;
+      x.axpy(alpha, p);
+      r.axpy(-alpha, q);
+
+      // keep the normalized direction
+      newP.push_back(p);
+      newP.back() *= 1.0 / std::sqrt(pq);
+      newBP.push_back(q);
+      newBP.back() *= 1.0 / std::sqrt(pq);
+
+      const double rhoNew = r.dot_product_with(r);
+      p *= rhoNew / rho;
+      p += r;
+      for (size_t i = 0; i < nw; i++)
+        p.axpy(-recycleBP_[i].dot_product_with(r), recycleP_[i]);
+      rho = rhoNew;
+    }
+
+    oops::Log::trace() << "Covariance::inverseMultiply: " << iter
+                       << " CG iterations, residual reduction "
+                       << (bnorm == 0.0 ? 0.0 : std::sqrt(rho) / bnorm)
+                       << ", " << nw << " recycled directions" << std::endl;
+
+    // keep the most recent directions
+    for (size_t i = 0; i < newP.size(); i++) {
+      recycleP_.push_back(std::move(newP[i]));
+      recycleBP_.push_back(std::move(newBP[i]));
+    }
+    if (recycleP_.size() > recycleMax_) {
+      const size_t drop = recycleP_.size() - recycleMax_;
+      recycleP_.erase(recycleP_.begin(), recycleP_.begin() + drop);
+      recycleBP_.erase(recycleBP_.begin(), recycleBP_.begin() + drop);
+    }
   }
 
 // ----------------------------------------------------------------------------
 
   void Covariance::multiply(const Increment & dxin, Increment & dxout) const {
     dxout = dxin;
-    saber::bump_apply_nicas_f90(keyBump_, (*dxout.atlasFieldSet()).get());
+    applyB(*dxout.atlasFieldSet());
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Covariance::applyB(atlas::FieldSet & fset) const {
+    // the ensemble part on a copy of the input
+    atlas::FieldSet ens;
+    if (ensemble_) {
+      ens = copyFields(fset);
+      ensemble_->multiply(ens);
+    }
+
+    if (staticWeight_ > 0.0) {
+      if (stddev_) stddev_->apply(fset, false);
+      applyBalance(fset, true, false);
+      for (const Block & block : blocks_) {
+        atlas::FieldSet sub = blockFields(fset, block);
+        block.correlation->multiply(sub);
+      }
+      applyBalance(fset, false, false);
+      if (stddev_) stddev_->apply(fset, false);
+    }
+
+    if (ensemble_) {
+      for (int f = 0; f < fset.size(); f++) {
+        double * y = make_view<double, 2>(fset[f]).data();
+        const double * e = make_view<double, 2>(
+          ens.field(fset[f].name())).data();
+        const double ws = staticWeight_;
+        const double we = ensembleWeight_;
+        const int n = fset[f].size();
+#pragma omp parallel for
+        for (int i = 0; i < n; i++)
+          y[i] = (ws > 0.0 ? ws*y[i] : 0.0) + we*e[i];
+      }
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Covariance::applyBInverse(atlas::FieldSet & fset) const {
+    if (stddev_) stddev_->apply(fset, true);
+    applyBalance(fset, false, true);
+    for (const Block & block : blocks_) {
+      atlas::FieldSet sub = blockFields(fset, block);
+      block.correlation->inverseMultiply(sub);
+    }
+    applyBalance(fset, true, true);
+    if (stddev_) stddev_->apply(fset, true);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Covariance::applyBalance(atlas::FieldSet & fset, const bool transpose,
+                                const bool inverse) const {
+    // K = K_n ... K_1 with K_i = I + c_i E_i, so K applies the terms in
+    // order and K^T in reverse order, and the inverses swap the order and
+    // the sign of c_i
+    const size_t n = balance_.size();
+    for (size_t e = 0; e < n; e++) {
+      const Balance & bal = balance_[transpose != inverse ? n-1-e : e];
+      const double c = inverse ? -bal.coef : bal.coef;
+      atlas::Field dst = fset.field(transpose ? bal.from : bal.var);
+      const atlas::Field src = fset.field(transpose ? bal.var : bal.from);
+      if (dst.size() != src.size())
+        util::abor1_cpp("Covariance::applyBalance(), " + bal.var + " and "
+                        + bal.from + " have different sizes",
+                        __FILE__, __LINE__);
+      double * y = make_view<double, 2>(dst).data();
+      const double * x = make_view<double, 2>(src).data();
+      for (size_t i = 0; i < dst.size(); i++)
+        y[i] += c * x[i];
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  atlas::FieldSet Covariance::copyFields(const atlas::FieldSet & fset) const {
+    atlas::FieldSet copy;
+    for (int f = 0; f < fset.size(); f++) {
+      atlas::Field fld = fset[f].functionspace().createField<double>(
+        atlas::option::levels(fset[f].levels()) |
+        atlas::option::name(fset[f].name()));
+      const double * src = make_view<double, 2>(fset[f]).data();
+      std::copy_n(src, fset[f].size(), make_view<double, 2>(fld).data());
+      copy.add(fld);
+    }
+    return copy;
+  }
+
+// ----------------------------------------------------------------------------
+
+  atlas::FieldSet Covariance::blockFields(const atlas::FieldSet & fset,
+                                          const Block & block) const {
+    atlas::FieldSet sub;
+    for (const std::string & var : block.vars)
+      sub.add(fset.field(var));
+    return sub;
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Covariance::multiply(const std::vector<Increment> & dxin,
+                            std::vector<Increment> & dxout) const {
+    const size_t nm = dxin.size();
+    if (dxout.size() != nm) dxout = dxin;
+    if (nm == 0) return;
+
+    atlas::FieldSet packed = packIncrements(dxin, true);
+    applyB(packed);
+    unpackIncrements(packed, dxout);
+  }
+
+// ----------------------------------------------------------------------------
+
+  atlas::FieldSet Covariance::packIncrements(const std::vector<Increment> & dx,
+                                             const bool copy) const {
+    // member m, level l of a field go to level m*nlev + l
+    const size_t nm = dx.size();
+    const atlas::FieldSet & first = *dx[0].atlasFieldSet();
+    atlas::FieldSet packed;
+    for (int f = 0; f < first.size(); f++) {
+      const int nlev = first[f].levels();
+      const int npts = first[f].shape(0);
+      atlas::Field fld = first[f].functionspace().createField<double>(
+        atlas::option::levels(nm*nlev) | atlas::option::name(first[f].name()));
+      double * dst = make_view<double, 2>(fld).data();
+      if (!copy) std::fill_n(dst, fld.size(), 0.0);
+      for (size_t m = 0; m < nm && copy; m++) {
+        const double * src = make_view<double, 2>(
+          dx[m].atlasFieldSet()->field(first[f].name())).data();
+        for (int k = 0; k < npts; k++)
+          std::copy_n(src + k*nlev, nlev, dst + (k*nm + m)*nlev);
+      }
+      packed.add(fld);
+    }
+    return packed;
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Covariance::unpackIncrements(const atlas::FieldSet & packed,
+                                    std::vector<Increment> & dx) const {
+    const size_t nm = dx.size();
+    for (int f = 0; f < packed.size(); f++) {
+      const int nlev = packed[f].levels() / nm;
+      const int npts = packed[f].shape(0);
+      const double * src = make_view<double, 2>(packed[f]).data();
+      for (size_t m = 0; m < nm; m++) {
+        double * dst = make_view<double, 2>(
+          dx[m].atlasFieldSet()->field(packed[f].name())).data();
+        for (int k = 0; k < npts; k++)
+          std::copy_n(src + (k*nm + m)*nlev, nlev, dst + k*nlev);
+      }
+    }
   }
 
 // ----------------------------------------------------------------------------
 
   void Covariance::randomize(Increment & dx) const {
-    dx.random();
+    // a new sample on each call
+    std::vector<Increment> dxs(1, dx);
+    randomize(dxs, randomCount_++);
+    dx = dxs[0];
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Covariance::randomize(std::vector<Increment> & dx, const size_t first,
+                             const size_t seed) const {
+    // B^1/2 xi = ws^1/2 S K U xi_s + we^1/2 Be^1/2 xi_e, with C = U U^T for
+    // each block. xi_s of sample "first" + m is the N(0,1) field of
+    // Increment::random(first + m, seed).
+    util::Timer timer(classname(), "randomize");
+    const size_t nm = dx.size();
+    if (nm == 0) return;
+    atlas::FieldSet packed = packIncrements(dx, false);
+    auto gidx = make_view<atlas::gidx_t, 1>(
+      dx[0].geometry()->atlasFunctionSpace()->global_index());
+
+    if (staticWeight_ > 0.0) {
+      const Philox rng(seed);
+      const oops::Variables & vars = dx[0].variables();
+      for (int f = 0; f < packed.size(); f++) {
+        const int nlev = packed[f].levels() / nm;
+        const int npts = packed[f].shape(0);
+        const size_t v = std::find(vars.variables().begin(),
+                                   vars.variables().end(), packed[f].name())
+                         - vars.variables().begin();
+        double * x = make_view<double, 2>(packed[f]).data();
+#pragma omp parallel for
+        for (int k = 0; k < npts; k++)
+          for (size_t m = 0; m < nm; m++)
+            for (int l = 0; l < nlev; l++)
+              x[(k*nm + m)*nlev + l] = rng.normal(gidx(k), l, v, first + m);
+      }
+
+      for (const Block & block : blocks_) {
+        atlas::FieldSet sub = blockFields(packed, block);
+        if (!block.correlation->hasRandomize())
+          util::abor1_cpp("Covariance::randomize(), the correlation model "
+                          "cannot be sampled", __FILE__, __LINE__);
+        block.correlation->randomize(sub);
+      }
+      applyBalance(packed, false, false);
+      if (stddev_) stddev_->apply(packed, false);
+      if (ensemble_) {
+        for (int f = 0; f < packed.size(); f++) {
+          double * x = make_view<double, 2>(packed[f]).data();
+          const double ws = std::sqrt(staticWeight_);
+          for (int i = 0; i < packed[f].size(); i++) x[i] *= ws;
+        }
+      }
+    }
+
+    if (ensemble_) {
+      atlas::FieldSet ens = copyFields(packed);
+      for (int f = 0; f < ens.size(); f++) {
+        double * x = make_view<double, 2>(ens[f]).data();
+        std::fill_n(x, ens[f].size(), 0.0);
+      }
+      ensemble_->randomize(ens, first, seed);
+      for (int f = 0; f < packed.size(); f++) {
+        double * y = make_view<double, 2>(packed[f]).data();
+        const double * e = make_view<double, 2>(
+          ens.field(packed[f].name())).data();
+        const double we = std::sqrt(ensembleWeight_);
+        for (int i = 0; i < packed[f].size(); i++) y[i] += we*e[i];
+      }
+    }
+
+    unpackIncrements(packed, dx);
   }
 
 // ----------------------------------------------------------------------------
 
   void Covariance::print(std::ostream & os) const {
-    os << "(TODO, print diagnostic info about the Covariance here)"
-       << std::endl;
+    for (const Block & block : blocks_) {
+      os << "Covariance block";
+      for (const std::string & var : block.vars) os << " " << var;
+      os << ": " << *block.correlation << std::endl;
+    }
+    for (const Balance & bal : balance_)
+      os << "Covariance balance: " << bal.var << " += " << bal.coef << " * "
+         << bal.from << std::endl;
+    if (stddev_) os << "Covariance " << *stddev_ << std::endl;
+    if (ensemble_)
+      os << "Covariance " << staticWeight_ << " static + " << ensembleWeight_
+         << " " << *ensemble_ << std::endl;
   }
 
 // ----------------------------------------------------------------------------
@@ -8,13 +8,18 @@
 #ifndef UMDSST_COVARIANCE_COVARIANCE_H_
 #define UMDSST_COVARIANCE_COVARIANCE_H_
 
+#include <memory>
 #include <ostream>
 #include <string>
+#include <vector>
 
 #include "oops/util/ObjectCounter.h"
 #include "oops/util/Printable.h"
 
 // forward declarations
+namespace atlas {
+  class FieldSet;
+}
 namespace eckit {
   class Configuration;
 }
@@ -22,9 +27,12 @@ namespace oops {
   class Variables;
 }
 namespace umdsst {
+  class CorrelationBase;
+  class EnsembleCovariance;
   class Geometry;
   class Increment;
   class State;
+  class StdDev;
 }
 
 // ----------------------------------------------------------------------------
@@ -46,12 +54,84 @@ namespace umdsst {
     // math routines
     void inverseMultiply(const Increment &, Increment &) const;
     void multiply(const Increment &, Increment &) const;
+    // B applied to a set of increments at once, packed as the levels of
+    // one set of fields so that the exchanges of the members are combined
+    // by the diffusion and recursive filter models (BUMP still applies
+    // NICAS to one member at a time)
+    void multiply(const std::vector<Increment> &,
+                  std::vector<Increment> &) const;
+    // a sample of B, B^1/2 xi with xi ~ N(0, I)
     void randomize(Increment &) const;
+    // samples "first" to "first" + n-1 of B, all at once. The samples only
+    // depend on their number and the seed, not on how they are batched
+    // (except for the BUMP blocks, which draw NICAS samples from BUMP's own
+    // random numbers).
+    void randomize(std::vector<Increment> &, const size_t first,
+                   const size_t seed = 1) const;
 
    private:
     void print(std::ostream &) const;
 
-    int keyBump_ = 0;
+    // B^-1 by conjugate gradients, deflated by the B-conjugate directions
+    // kept from the previous calls
+    void recycledCG(const Increment &, Increment &) const;
+
+    // B = S K C K^T S, with C block diagonal. The variables that have the same
+    // correlation settings ("correlation model", "correlation lengths" and
+    // the model's own section, which can be overridden per variable in
+    // "variables.<name>") share one block, whose operator is applied to all
+    // of them at once. K is an optional scalar balance, each term adding
+    // "coefficient" times the "from" variable to "variable". S is the
+    // optional "standard deviation", applied in the same pass as C.
+    struct Block {
+      std::vector<std::string> vars;
+      std::unique_ptr<CorrelationBase> correlation;
+    };
+    struct Balance {
+      std::string var;
+      std::string from;
+      double coef;
+    };
+    std::vector<Block> blocks_;
+    std::vector<Balance> balance_;
+    std::unique_ptr<StdDev> stddev_;
+
+    // optional hybrid, B = staticWeight_ Bs + ensembleWeight_ Be, with Bs
+    // the static B above and Be the localized ensemble covariance
+    std::unique_ptr<EnsembleCovariance> ensemble_;
+    double staticWeight_;
+    double ensembleWeight_;
+
+    // B, B^-1 (with the exact inverse of C) and K, K^T, K^-1 or K^-T,
+    // in place on the fields of the analysis variables
+    void applyB(atlas::FieldSet &) const;
+    void applyBInverse(atlas::FieldSet &) const;
+    void applyBalance(atlas::FieldSet &, const bool, const bool) const;
+    atlas::FieldSet blockFields(const atlas::FieldSet &, const Block &) const;
+    atlas::FieldSet copyFields(const atlas::FieldSet &) const;
+
+    // the increments packed as the levels of one set of fields (member m,
+    // level l at level m*nlev + l), zero unless copied, and back
+    atlas::FieldSet packIncrements(const std::vector<Increment> &,
+                                   const bool copy) const;
+    void unpackIncrements(const atlas::FieldSet &,
+                          std::vector<Increment> &) const;
+
+    // inverseMultiply settings, "inverse.method" is "exact" (the inverse of
+    // the correlation models), "cg" (recycled CG) or "auto" (exact if all
+    // the models have an inverse, cg otherwise)
+    bool exactInverse_;
+    double inverseTolerance_;
+    int inverseMaxIter_;
+    size_t recycleMax_;
+
+    // B-orthonormal directions p (p^T B p = 1) and B p from previous CG
+    // solves, oldest first
+    mutable std::vector<Increment> recycleP_;
+    mutable std::vector<Increment> recycleBP_;
+
+    // number of samples drawn by randomize(Increment &)
+    mutable size_t randomCount_;
   };
 
 }  // namespace umdsst
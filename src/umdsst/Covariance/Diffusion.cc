@@ -0,0 +1,405 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "umdsst/Covariance/Diffusion.h"
+#include "umdsst/Geometry/Geometry.h"
+#include "umdsst/Utils/Philox.h"
+
+#include "eckit/config/Configuration.h"
+#include "eckit/config/LocalConfiguration.h"
+#include "eckit/mpi/Comm.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
+#include "atlas/grid.h"
+#include "atlas/option.h"
+#include "atlas/util/Earth.h"
+
+#include "oops/util/abor1_cpp.h"
+#include "oops/util/Logger.h"
+#include "oops/util/Timer.h"
+
+using atlas::array::make_view;
+
+namespace umdsst {
+
+// ----------------------------------------------------------------------------
+
+  Diffusion::Diffusion(const Geometry & geom,
+                       const eckit::Configuration & conf)
+    : comm_(geom.getComm()), haloFs_(*geom.atlasFunctionSpaceHalo()) {
+    eckit::LocalConfiguration diffConf;
+    conf.get("diffusion", diffConf);
+    steps_ = diffConf.getInt("steps", 10);
+    tolerance_ = diffConf.getDouble("tolerance", 1.0e-10);
+    maxIter_ = diffConf.getInt("max iterations", 500);
+    normalization_ = diffConf.getString("normalization", "analytic");
+
+    // M has to be even for the square root
+    if (steps_ < 2 || steps_ % 2 != 0)
+      util::abor1_cpp("Diffusion::Diffusion(), \"steps\" must be even",
+                      __FILE__, __LINE__);
+    if (!conf.has("correlation lengths"))
+      util::abor1_cpp("Diffusion::Diffusion(), \"correlation lengths\" "
+                      "required", __FILE__, __LINE__);
+
+    const atlas::functionspace::StructuredColumns & fs =
+      *geom.atlasFunctionSpace();
+    const atlas::StructuredGrid & grid = fs.grid();
+    const int ny = static_cast<int>(grid.ny());
+    nOwned_ = fs.size();
+
+    // diffusivity and land mask, with their halo
+    const atlas::Field lengths = correlationLengths(geom, conf);
+    auto lengths_view = make_view<double, 2>(lengths);
+    atlas::Field kappa = haloFs_.createField<double>(atlas::option::levels(1));
+    atlas::Field mask = haloFs_.createField<double>(atlas::option::levels(1));
+    auto kappa_view = make_view<double, 2>(kappa);
+    auto mask_view = make_view<double, 2>(mask);
+    const bool hasMask = geom.atlasFieldSet()->has_field("gmask");
+
+    ownedHalo_.resize(nOwned_);
+    std::vector<int> row(nOwned_), col(nOwned_);
+    for (int j = fs.j_begin(); j < fs.j_end(); j++) {
+      for (int i = fs.i_begin(j); i < fs.i_end(j); i++) {
+        const int k = fs.index(i, j);
+        const int h = haloFs_.index(i, j);
+        ownedHalo_[k] = h;
+        row[k] = j;
+        col[k] = i;
+        kappa_view(h, 0) = lengths_view(k, 0)*lengths_view(k, 0)
+                           / (2.0*steps_);
+        mask_view(h, 0) = 1.0;
+      }
+    }
+    if (hasMask) {
+      auto gmask = make_view<int, 2>(geom.atlasFieldSet()->field("gmask"));
+      for (size_t k = 0; k < nOwned_; k++)
+        mask_view(ownedHalo_[k], 0) = gmask(k, 0) == 0 ? 0.0 : 1.0;
+    }
+    haloFs_.haloExchange(kappa);
+    haloFs_.haloExchange(mask);
+
+    // the stencil. The flux through a face is kappa times the ratio of the
+    // face length to the distance between the points, the radius cancels out
+    const double radius = atlas::util::DatumIFS::radius();
+    const double dlon = 2.0 * M_PI / grid.nxmax();
+    const double dlat = ny > 1 ? std::abs(grid.y(1) - grid.y(0))*M_PI/180.0
+                               : M_PI;
+    auto cosLat = [](const double lat) {
+      return std::max(std::cos(lat*M_PI/180.0), 1.0e-6);
+    };
+
+    nb_.resize(4*nOwned_);
+    trans_.resize(4*nOwned_);
+    area_.resize(nOwned_);
+    diagA_.resize(nOwned_);
+    for (size_t k = 0; k < nOwned_; k++) {
+      const int i = col[k], j = row[k], h = ownedHalo_[k];
+      const double c = cosLat(grid.y(j));
+      area_[k] = radius*radius*c*dlon*dlat;
+
+      // E, W, N, S neighbors and the geometric factor of their face
+      const int ni[4] = {i+1, i-1, i, i};
+      const int nj[4] = {j, j, j-1, j+1};
+      double g[4] = {dlat/(c*dlon), dlat/(c*dlon), 0.0, 0.0};
+      if (j > 0)
+        g[2] = cosLat(0.5*(grid.y(j) + grid.y(j-1)))*dlon/dlat;
+      if (j < ny-1)
+        g[3] = cosLat(0.5*(grid.y(j) + grid.y(j+1)))*dlon/dlat;
+
+      diagA_[k] = area_[k];
+      for (int d = 0; d < 4; d++) {
+        nb_[4*k+d] = h;
+        trans_[4*k+d] = 0.0;
+        if (g[d] == 0.0) continue;
+        const int hn = haloFs_.index(ni[d], nj[d]);
+        if (mask_view(h, 0) == 0.0 || mask_view(hn, 0) == 0.0) continue;
+        nb_[4*k+d] = hn;
+        trans_[4*k+d] = 0.5*(kappa_view(h, 0) + kappa_view(hn, 0))*g[d];
+        diagA_[k] += trans_[4*k+d];
+      }
+    }
+
+    // normalization, land points are left out of the correlation
+    gamma_.assign(nOwned_, 0.0);
+    if (normalization_ == "analytic") {
+      normalizeAnalytic(lengths);
+    } else if (normalization_ == "randomization") {
+      normalizeRandomized(geom, diffConf.getInt("randomization members", 100),
+                          diffConf.getInt("randomization seed", 1));
+    } else {
+      util::abor1_cpp("Diffusion::Diffusion(), unknown normalization \""
+                      + normalization_ + "\"", __FILE__, __LINE__);
+    }
+    for (size_t k = 0; k < nOwned_; k++)
+      if (mask_view(ownedHalo_[k], 0) == 0.0) gamma_[k] = 0.0;
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Diffusion::normalizeAnalytic(const atlas::Field & lengths) {
+    // The kernel of (1 - kappa lap)^-M has the value M/(2 pi Lh^2 (M-1)) at
+    // its center. Lengths shorter than the grid spacing tend to the identity,
+    // for which G^2 = W.
+    auto lengths_view = make_view<double, 2>(lengths);
+    for (size_t k = 0; k < nOwned_; k++) {
+      const double lh = lengths_view(k, 0);
+      gamma_[k] = std::sqrt(std::max(2.0*M_PI*lh*lh*(steps_-1)/steps_,
+                                     area_[k]));
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Diffusion::normalizeRandomized(const Geometry & geom,
+                                      const int members, const size_t seed) {
+    // var(U x) for x ~ N(0, I) is the diagonal of U U^T, estimated with all
+    // the members at once by using them as the levels of one field
+    auto gidx = make_view<atlas::gidx_t, 1>(
+      geom.atlasFunctionSpace()->global_index());
+    const Philox rng(seed);
+    std::vector<double> x(nOwned_*members);
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int m = 0; m < members; m++)
+        x[k*members+m] = rng.normal(gidx(k), 0, 0, m) / std::sqrt(area_[k]);
+
+    for (int s = 0; s < steps_/2; s++)
+      diffusionStep(x, members);
+
+    for (size_t k = 0; k < nOwned_; k++) {
+      double var = 0.0;
+      for (int m = 0; m < members; m++)
+        var += x[k*members+m]*x[k*members+m];
+      var /= members;
+      gamma_[k] = var > 0.0 ? 1.0/std::sqrt(var) : 0.0;
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Diffusion::multiply(atlas::FieldSet & fset) const {
+    util::Timer timer("umdsst::Diffusion", "multiply");
+    std::vector<double> x;
+    const int nlev = packLevels(fset, x);
+
+    // W^-1 G
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        x[k*nlev+l] = gamma_[k] == 0.0 ? 0.0 :
+                      gamma_[k] * x[k*nlev+l] / area_[k];
+
+    // L^M
+    for (int s = 0; s < steps_; s++)
+      diffusionStep(x, nlev);
+
+    // G
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        x[k*nlev+l] *= gamma_[k];
+    unpackLevels(x, fset);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Diffusion::sqrtMultiply(atlas::FieldSet & fset) const {
+    std::vector<double> x;
+    const int nlev = packLevels(fset, x);
+
+    // W^-1/2
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        x[k*nlev+l] = gamma_[k] == 0.0 ? 0.0 :
+                      x[k*nlev+l] / std::sqrt(area_[k]);
+
+    // L^(M/2)
+    for (int s = 0; s < steps_/2; s++)
+      diffusionStep(x, nlev);
+
+    // G
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        x[k*nlev+l] *= gamma_[k];
+    unpackLevels(x, fset);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Diffusion::inverseMultiply(atlas::FieldSet & fset) const {
+    // no linear solves needed, only applications of A
+    util::Timer timer("umdsst::Diffusion", "inverseMultiply");
+    std::vector<double> x;
+    const int nlev = packLevels(fset, x);
+    atlas::Field work = haloFs_.createField<double>(
+      atlas::option::levels(nlev));
+    std::vector<double> y(x.size());
+
+    // G^-1, the pseudo-inverse on land
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        x[k*nlev+l] = gamma_[k] == 0.0 ? 0.0 : x[k*nlev+l] / gamma_[k];
+
+    // (W^-1 A)^M
+    for (int s = 0; s < steps_; s++) {
+      applyA(x, y, work, nlev);
+      for (size_t k = 0; k < nOwned_; k++)
+        for (int l = 0; l < nlev; l++)
+          x[k*nlev+l] = y[k*nlev+l] / area_[k];
+    }
+
+    // W G^-1
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        x[k*nlev+l] = gamma_[k] == 0.0 ? 0.0 :
+                      area_[k] * x[k*nlev+l] / gamma_[k];
+    unpackLevels(x, fset);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Diffusion::diffusionStep(std::vector<double> & x,
+                                const int nlev) const {
+    // solve A x_new = W x with Jacobi preconditioned CG, all levels at once
+    // with their own step sizes, starting from x_new = x
+    const size_t n = nOwned_*nlev;
+    atlas::Field work = haloFs_.createField<double>(
+      atlas::option::levels(nlev));
+    std::vector<double> b(n), r(n), z(n), p(n), q(n);
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        b[k*nlev+l] = area_[k] * x[k*nlev+l];
+
+    applyA(x, q, work, nlev);
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++) {
+        const size_t kl = k*nlev+l;
+        r[kl] = b[kl] - q[kl];
+        z[kl] = r[kl] / diagA_[k];
+      }
+    p = z;
+
+    // r.z, r.r and b.b of each level, reduced over the PEs together
+    std::vector<double> sums(3*nlev), pq(nlev);
+    levelSums(r, z, nlev, &sums[0]);
+    levelSums(r, r, nlev, &sums[nlev]);
+    levelSums(b, b, nlev, &sums[2*nlev]);
+    comm_.allReduceInPlace(sums.data(), sums.size(),
+                           eckit::mpi::Operation::SUM);
+    std::vector<double> rho(sums.begin(), sums.begin() + nlev);
+    const std::vector<double> bb(sums.begin() + 2*nlev, sums.end());
+    std::vector<char> active(nlev);
+    auto converged = [&]() {
+      bool all = true;
+      for (int l = 0; l < nlev; l++) {
+        active[l] = sums[nlev+l] > tolerance_*tolerance_*bb[l];
+        all = all && !active[l];
+      }
+      return all;
+    };
+
+    int iter = 0;
+    for (; iter < maxIter_ && !converged(); iter++) {
+      applyA(p, q, work, nlev);
+      levelSums(p, q, nlev, pq.data());
+      comm_.allReduceInPlace(pq.data(), pq.size(),
+                             eckit::mpi::Operation::SUM);
+
+      std::vector<double> alpha(nlev, 0.0);
+      for (int l = 0; l < nlev; l++)
+        if (active[l]) alpha[l] = rho[l] / pq[l];
+
+      #pragma omp parallel for
+      for (int k = 0; k < static_cast<int>(nOwned_); k++)
+        for (int l = 0; l < nlev; l++) {
+          const size_t kl = k*nlev+l;
+          x[kl] += alpha[l]*p[kl];
+          r[kl] -= alpha[l]*q[kl];
+          z[kl] = r[kl] / diagA_[k];
+        }
+
+      levelSums(r, z, nlev, &sums[0]);
+      levelSums(r, r, nlev, &sums[nlev]);
+      comm_.allReduceInPlace(sums.data(), 2*nlev,
+                             eckit::mpi::Operation::SUM);
+
+      std::vector<double> beta(nlev, 0.0);
+      for (int l = 0; l < nlev; l++) {
+        if (active[l]) beta[l] = sums[l] / rho[l];
+        rho[l] = sums[l];
+      }
+
+      #pragma omp parallel for
+      for (int k = 0; k < static_cast<int>(nOwned_); k++)
+        for (int l = 0; l < nlev; l++) {
+          const size_t kl = k*nlev+l;
+          if (active[l]) p[kl] = z[kl] + beta[l]*p[kl];
+        }
+    }
+
+    if (iter == maxIter_ && !converged())
+      oops::Log::warning() << "Diffusion: CG not converged after " << iter
+                           << " iterations" << std::endl;
+    oops::Log::debug() << "Diffusion: CG iterations " << iter << std::endl;
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Diffusion::applyA(const std::vector<double> & x,
+                         std::vector<double> & y,
+                         atlas::Field & work, const int nlev) const {
+    double * w = make_view<double, 2>(work).data();
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        w[ownedHalo_[k]*nlev+l] = x[k*nlev+l];
+    haloFs_.haloExchange(work);
+
+    #pragma omp parallel for
+    for (int k = 0; k < static_cast<int>(nOwned_); k++) {
+      const int * nb = &nb_[4*k];
+      const double * t = &trans_[4*k];
+      for (int l = 0; l < nlev; l++) {
+        y[k*nlev+l] = diagA_[k]*w[ownedHalo_[k]*nlev+l]
+                    - t[0]*w[nb[0]*nlev+l] - t[1]*w[nb[1]*nlev+l]
+                    - t[2]*w[nb[2]*nlev+l] - t[3]*w[nb[3]*nlev+l];
+      }
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Diffusion::levelSums(const std::vector<double> & a,
+                            const std::vector<double> & b,
+                            const int nlev, double * sums) const {
+    std::fill(sums, sums + nlev, 0.0);
+    #pragma omp parallel
+    {
+      std::vector<double> local(nlev, 0.0);
+      #pragma omp for nowait
+      for (int k = 0; k < static_cast<int>(nOwned_); k++)
+        for (int l = 0; l < nlev; l++)
+          local[l] += a[k*nlev+l]*b[k*nlev+l];
+      #pragma omp critical
+      for (int l = 0; l < nlev; l++)
+        sums[l] += local[l];
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Diffusion::print(std::ostream & os) const {
+    os << "Diffusion: " << steps_ << " implicit steps, " << normalization_
+       << " normalization";
+  }
+
+// ----------------------------------------------------------------------------
+
+}  // namespace umdsst
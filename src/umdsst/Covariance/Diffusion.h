@@ -0,0 +1,96 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_COVARIANCE_DIFFUSION_H_
+#define UMDSST_COVARIANCE_DIFFUSION_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "umdsst/Covariance/CorrelationBase.h"
+
+#include "atlas/functionspace.h"
+
+// forward declarations
+namespace eckit {
+  namespace mpi {
+    class Comm;
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+namespace umdsst {
+
+  // Correlation operator given by M steps of implicit diffusion on the
+  // lat-lon grid (Weaver and Courtier, 2001; Mirouze and Weaver, 2010):
+  //
+  //   C = G L^M W^-1 G,   L = A^-1 W,   A = W - div(kappa grad)
+  //
+  // W is the diagonal matrix of the grid cell areas, kappa = Lh^2 / (2M) for
+  // the gaussian length scale Lh, and G is the diagonal normalization that
+  // gives C a unit diagonal. There is no diffusion across land or across the
+  // poles. Each step is a Jacobi preconditioned conjugate gradient solve, the
+  // square root U = G L^(M/2) W^(-1/2) and the inverse
+  // C^-1 = G^-1 W (W^-1 A)^M G^-1 follow from the same operator.
+  class Diffusion : public CorrelationBase {
+   public:
+    Diffusion(const Geometry &, const eckit::Configuration &);
+    ~Diffusion() {}
+
+    void multiply(atlas::FieldSet &) const override;
+
+    bool hasInverse() const override { return true; }
+    void inverseMultiply(atlas::FieldSet &) const override;
+
+    bool hasSqrt() const override { return true; }
+    void sqrtMultiply(atlas::FieldSet &) const override;
+
+   private:
+    void print(std::ostream &) const override;
+
+    // x = A^-1 W x, applied to nlev independent levels
+    void diffusionStep(std::vector<double> &, const int) const;
+
+    // y = A x, x is copied into the halo work field to get its neighbors
+    void applyA(const std::vector<double> &, std::vector<double> &,
+                atlas::Field &, const int) const;
+
+    // local per level sums of a*b, over the owned points
+    void levelSums(const std::vector<double> &, const std::vector<double> &,
+                   const int, double *) const;
+
+    // G computed from either the analytic variance of the continuous
+    // operator, or the sample variance of U applied to random vectors
+    void normalizeAnalytic(const atlas::Field &);
+    void normalizeRandomized(const Geometry &, const int, const size_t);
+
+    const eckit::mpi::Comm & comm_;
+    atlas::functionspace::StructuredColumns haloFs_;
+
+    int steps_;
+    double tolerance_;
+    int maxIter_;
+    std::string normalization_;
+
+    // for each owned point: its index in the halo function space, the
+    // halo indices of its E, W, N and S neighbors and the face
+    // transmissibilities (0 across land and the poles), the cell area,
+    // the diagonal of A, and the normalization (0 on land)
+    size_t nOwned_;
+    std::vector<int> ownedHalo_;
+    std::vector<int> nb_;
+    std::vector<double> trans_;
+    std::vector<double> area_;
+    std::vector<double> diagA_;
+    std::vector<double> gamma_;
+  };
+
+}  // namespace umdsst
+
+#endif  // UMDSST_COVARIANCE_DIFFUSION_H_
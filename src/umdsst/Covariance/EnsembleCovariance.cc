@@ -0,0 +1,277 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "umdsst/Covariance/CorrelationBase.h"
+#include "umdsst/Covariance/EnsembleCovariance.h"
+#include "umdsst/Fields/Fields.h"
+#include "umdsst/Geometry/Geometry.h"
+#include "umdsst/Utils/Philox.h"
+
+#include "eckit/config/Configuration.h"
+#include "eckit/config/LocalConfiguration.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
+#include "atlas/option.h"
+
+#include "oops/base/Variables.h"
+#include "oops/util/abor1_cpp.h"
+#include "oops/util/DateTime.h"
+#include "oops/util/Logger.h"
+#include "oops/util/missingValues.h"
+#include "oops/util/Timer.h"
+
+using atlas::array::make_view;
+
+namespace umdsst {
+
+namespace {
+  // read the members one at a time into the block, and replace them by
+  // their perturbations. The mean is kept in double precision. Points
+  // missing in any member get a perturbation of 0.
+  template <typename T>
+  void loadMembers(Fields & member,
+                   const std::vector<eckit::LocalConfiguration> & confs,
+                   const std::vector<std::string> & vars,
+                   const std::vector<int> & levels,
+                   const std::vector<size_t> & offset, std::vector<T> & block) {
+    const size_t nm = confs.size();
+    const double missing = util::missingValue(missing);
+    std::vector<std::vector<double>> mean(vars.size());
+    std::vector<std::vector<char>> valid(vars.size());
+    for (size_t v = 0; v < vars.size(); v++) {
+      const size_t n = member.atlasFieldSet()->field(vars[v]).size();
+      mean[v].assign(n, 0.0);
+      valid[v].assign(n, 1);
+    }
+
+    for (size_t m = 0; m < nm; m++) {
+      member.read(confs[m]);
+      for (size_t v = 0; v < vars.size(); v++) {
+        const double * x = member.fieldData(vars[v]);
+        const int nlev = levels[v];
+        const size_t npts = mean[v].size() / nlev;
+        T * e = block.data() + offset[v];
+        for (size_t k = 0; k < npts; k++)
+          for (int l = 0; l < nlev; l++) {
+            const size_t i = k*nlev + l;
+            if (x[i] == missing) {
+              valid[v][i] = 0;
+              continue;
+            }
+            mean[v][i] += x[i] / nm;
+            e[(k*nm + m)*nlev + l] = static_cast<T>(x[i]);
+          }
+      }
+    }
+
+    const double scale = 1.0 / std::sqrt(nm - 1.0);
+    for (size_t v = 0; v < vars.size(); v++) {
+      const int nlev = levels[v];
+      const size_t npts = mean[v].size() / nlev;
+      T * e = block.data() + offset[v];
+      for (size_t k = 0; k < npts; k++)
+        for (size_t m = 0; m < nm; m++)
+          for (int l = 0; l < nlev; l++) {
+            const size_t i = k*nlev + l;
+            T & x = e[(k*nm + m)*nlev + l];
+            x = valid[v][i] ? static_cast<T>((x - mean[v][i]) * scale) : 0;
+          }
+    }
+  }
+}  // namespace
+
+// ----------------------------------------------------------------------------
+
+  EnsembleCovariance::EnsembleCovariance(const Geometry & geom,
+                                         const oops::Variables & vars,
+                                         const eckit::Configuration & conf)
+    : vars_(vars.variables()) {
+    util::Timer timer("umdsst::EnsembleCovariance", "EnsembleCovariance");
+    std::vector<eckit::LocalConfiguration> memberConfs =
+      conf.getSubConfigurations("members");
+    members_ = memberConfs.size();
+    if (members_ < 2)
+      util::abor1_cpp("EnsembleCovariance::EnsembleCovariance(), at least 2 "
+                      "members needed", __FILE__, __LINE__);
+    const bool kelvin = conf.getBool("kelvin", false);
+    for (eckit::LocalConfiguration & member : memberConfs)
+      if (!member.has("kelvin")) member.set("kelvin", kelvin);
+    singlePrecision_ = conf.getBool("single precision", false);
+
+    Fields member(geom, vars, util::DateTime());
+    size_t size = 0;
+    for (const std::string & var : vars_) {
+      const atlas::Field fld = member.atlasFieldSet()->field(var);
+      levels_.push_back(fld.levels());
+      offset_.push_back(size);
+      size += fld.size() * members_;
+    }
+    if (singlePrecision_) {
+      pertFloat_.resize(size);
+      loadMembers(member, memberConfs, vars_, levels_, offset_, pertFloat_);
+    } else {
+      pertDouble_.resize(size);
+      loadMembers(member, memberConfs, vars_, levels_, offset_, pertDouble_);
+    }
+
+    if (!conf.has("localization"))
+      util::abor1_cpp("EnsembleCovariance::EnsembleCovariance(), "
+                      "\"localization\" required", __FILE__, __LINE__);
+    localization_.reset(CorrelationBase::create(
+      geom, vars, eckit::LocalConfiguration(conf, "localization")));
+
+    // the global indices, which key the random numbers of randomize
+    auto gidx = make_view<atlas::gidx_t, 1>(
+      geom.atlasFunctionSpace()->global_index());
+    gidx_.resize(geom.atlasFunctionSpace()->size());
+    for (size_t k = 0; k < gidx_.size(); k++) gidx_[k] = gidx(k);
+  }
+
+// ----------------------------------------------------------------------------
+
+  EnsembleCovariance::~EnsembleCovariance() {}
+
+// ----------------------------------------------------------------------------
+
+  void EnsembleCovariance::multiply(atlas::FieldSet & fset) const {
+    util::Timer timer("umdsst::EnsembleCovariance", "multiply");
+    if (singlePrecision_) {
+      atlas::FieldSet packed = schurMembers(pertFloat_.data(), fset);
+      localization_->multiply(packed);
+      sumMembers(pertFloat_.data(), packed, fset, false);
+    } else {
+      atlas::FieldSet packed = schurMembers(pertDouble_.data(), fset);
+      localization_->multiply(packed);
+      sumMembers(pertDouble_.data(), packed, fset, false);
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  bool EnsembleCovariance::hasRandomize() const {
+    return localization_->hasRandomize();
+  }
+
+// ----------------------------------------------------------------------------
+
+  void EnsembleCovariance::randomize(atlas::FieldSet & fset,
+                                     const size_t first,
+                                     const size_t seed) const {
+    // Be = sum_m X_m U U^T X_m, so Be^1/2 xi = sum_m X_m U xi_m with one
+    // independent noise xi_m per member. Its streams are told apart from
+    // those of the static B by the top bit of the variable key.
+    util::Timer timer("umdsst::EnsembleCovariance", "randomize");
+    if (!hasRandomize())
+      util::abor1_cpp("EnsembleCovariance::randomize(), the localization "
+                      "cannot be sampled", __FILE__, __LINE__);
+    const Philox rng(seed);
+    const int nm = members_;
+    atlas::FieldSet noise;
+    for (size_t v = 0; v < vars_.size(); v++) {
+      const atlas::Field fld = fset.field(vars_[v]);
+      const int nlev = fld.levels();
+      const int nlevE = levels_[v];
+      const int npts = fld.shape(0);
+      atlas::Field nfld = fld.functionspace().createField<double>(
+        atlas::option::levels(nm*nlev) | atlas::option::name(vars_[v]));
+      double * xi = make_view<double, 2>(nfld).data();
+#pragma omp parallel for
+      for (int k = 0; k < npts; k++)
+        for (int m = 0; m < nm; m++)
+          for (int f = 0; f < nlev; f++) {
+            const uint32_t key = 0x80000000u | (m << 8) | v;
+            xi[(k*nm + m)*nlev + f] = rng.normal(gidx_[k], f % nlevE, key,
+                                                 first + f / nlevE);
+          }
+      noise.add(nfld);
+    }
+
+    localization_->randomize(noise);
+    if (singlePrecision_)
+      sumMembers(pertFloat_.data(), noise, fset, true);
+    else
+      sumMembers(pertDouble_.data(), noise, fset, true);
+  }
+
+// ----------------------------------------------------------------------------
+
+  template <typename T>
+  atlas::FieldSet EnsembleCovariance::schurMembers(
+    const T * pert, const atlas::FieldSet & fset) const {
+    const int nm = members_;
+    atlas::FieldSet packed;
+    for (size_t v = 0; v < vars_.size(); v++) {
+      const atlas::Field fld = fset.field(vars_[v]);
+      const int nlev = fld.levels();
+      const int nlevE = levels_[v];
+      const int npts = fld.shape(0);
+      atlas::Field pfld = fld.functionspace().createField<double>(
+        atlas::option::levels(nm*nlev) | atlas::option::name(vars_[v]));
+      const double * x = make_view<double, 2>(fld).data();
+      double * p = make_view<double, 2>(pfld).data();
+      const T * e = pert + offset_[v];
+#pragma omp parallel for
+      for (int k = 0; k < npts; k++)
+        for (int m = 0; m < nm; m++) {
+          const T * ek = e + (k*nm + m)*nlevE;
+          double * pk = p + (k*nm + m)*nlev;
+          for (int f = 0; f < nlev; f++)
+            pk[f] = ek[f % nlevE] * x[k*nlev + f];
+        }
+      packed.add(pfld);
+    }
+    return packed;
+  }
+
+// ----------------------------------------------------------------------------
+
+  template <typename T>
+  void EnsembleCovariance::sumMembers(const T * pert,
+                                      const atlas::FieldSet & packed,
+                                      atlas::FieldSet & fset,
+                                      const bool add) const {
+    const int nm = members_;
+    for (size_t v = 0; v < vars_.size(); v++) {
+      atlas::Field fld = fset.field(vars_[v]);
+      const int nlev = fld.levels();
+      const int nlevE = levels_[v];
+      const int npts = fld.shape(0);
+      double * x = make_view<double, 2>(fld).data();
+      const double * p = make_view<double, 2>(packed.field(vars_[v])).data();
+      const T * e = pert + offset_[v];
+#pragma omp parallel for
+      for (int k = 0; k < npts; k++) {
+        double * xk = x + k*nlev;
+        if (!add)
+          for (int f = 0; f < nlev; f++) xk[f] = 0.0;
+        for (int m = 0; m < nm; m++) {
+          const T * ek = e + (k*nm + m)*nlevE;
+          const double * pk = p + (k*nm + m)*nlev;
+          for (int f = 0; f < nlev; f++)
+            xk[f] += ek[f % nlevE] * pk[f];
+        }
+      }
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void EnsembleCovariance::print(std::ostream & os) const {
+    os << "ensemble of " << members_ << " members ("
+       << (singlePrecision_ ? "single" : "double") << " precision), "
+       << "localization " << *localization_;
+  }
+
+// ----------------------------------------------------------------------------
+
+}  // namespace umdsst
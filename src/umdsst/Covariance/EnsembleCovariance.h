@@ -0,0 +1,98 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_COVARIANCE_ENSEMBLECOVARIANCE_H_
+#define UMDSST_COVARIANCE_ENSEMBLECOVARIANCE_H_
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "oops/util/Printable.h"
+
+// forward declarations
+namespace atlas {
+  class FieldSet;
+}
+namespace eckit {
+  class Configuration;
+}
+namespace oops {
+  class Variables;
+}
+namespace umdsst {
+  class CorrelationBase;
+  class Geometry;
+}
+
+// ----------------------------------------------------------------------------
+
+namespace umdsst {
+
+  // Localized ensemble covariance
+  //
+  //   Be x = sum_m x'_m o L (x'_m o x)
+  //
+  // where x'_m are the perturbations of the "members" around their mean,
+  // divided by sqrt(N-1), o is the Schur product and L the "localization",
+  // one of the correlation models (C) applied to all the members at once.
+  // The diffusion and recursive filter models combine the exchanges of the
+  // members; a BUMP localization applies NICAS to one member at a time, so
+  // its cost grows with N.
+  //
+  // The perturbations are read once and held in one contiguous block,
+  // optionally in "single precision". Within each variable the block is
+  // point-major with the members of a point next to each other, which is
+  // the layout of the members packed as the levels of L, so that the Schur
+  // products stream through the block and the packed fields together.
+  class EnsembleCovariance : public util::Printable {
+   public:
+    EnsembleCovariance(const Geometry &, const oops::Variables &,
+                       const eckit::Configuration &);
+    ~EnsembleCovariance();
+
+    // Be in place. A field can have several copies of the levels of the
+    // perturbations (the members of a batch packed as levels).
+    void multiply(atlas::FieldSet &) const;
+
+    // adds Be^1/2 xi, a sample of Be, to the fields. Each level f of a field
+    // is sample "first" + f / (levels of the perturbations), the noise
+    // only depends on the samples and the seed.
+    void randomize(atlas::FieldSet &, const size_t first,
+                   const size_t seed) const;
+    bool hasRandomize() const;
+
+    size_t members() const { return members_; }
+
+   private:
+    void print(std::ostream &) const override;
+
+    // x'_m o x for all the members, packed as levels (point k, member m,
+    // level f of x at (k*N + m)*nlev + f), and its adjoint sum_m x'_m o p_m,
+    // which overwrites or is added to x
+    template <typename T>
+    atlas::FieldSet schurMembers(const T *, const atlas::FieldSet &) const;
+    template <typename T>
+    void sumMembers(const T *, const atlas::FieldSet &, atlas::FieldSet &,
+                    const bool add) const;
+
+    std::vector<std::string> vars_;
+    std::vector<int> levels_;
+    std::vector<size_t> offset_;  // start of each variable in the block
+    size_t members_;
+    bool singlePrecision_;
+    std::vector<float> pertFloat_;
+    std::vector<double> pertDouble_;
+    std::unique_ptr<CorrelationBase> localization_;
+    std::vector<uint64_t> gidx_;
+  };
+
+}  // namespace umdsst
+
+#endif  // UMDSST_COVARIANCE_ENSEMBLECOVARIANCE_H_
@@ -0,0 +1,531 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "umdsst/Covariance/RecursiveFilter.h"
+#include "umdsst/Geometry/Geometry.h"
+#include "umdsst/Utils/Philox.h"
+
+#include "eckit/config/Configuration.h"
+#include "eckit/config/LocalConfiguration.h"
+#include "eckit/mpi/Comm.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
+#include "atlas/grid.h"
+#include "atlas/util/Earth.h"
+
+#include "oops/util/abor1_cpp.h"
+#include "oops/util/Logger.h"
+#include "oops/util/Timer.h"
+
+using atlas::array::make_view;
+
+namespace umdsst {
+
+// ----------------------------------------------------------------------------
+
+  namespace {
+    // number of interleaved lines handled together by one thread
+    const int lineBlock = 64;
+
+    // y_i = x_i + c_i y_i-dir, in place along the n points of m interleaved
+    // lines (x[i*m + r]). If cyclic, y_-1 = y_n-1 (or y_n = y_0): the
+    // solution is the non cyclic one plus y_n-1 times the running products
+    // of c, which vanish after the first land point.
+    void recurse(double * x, const double * c, const int n, const int m,
+                 const int dir, const bool cyclic) {
+      const int first = dir > 0 ? 0 : n-1;
+      const int last = n-1-first;
+      #pragma omp parallel for
+      for (int r0 = 0; r0 < m; r0 += lineBlock) {
+        const int r1 = std::min(m, r0 + lineBlock);
+        for (int s = 1; s < n; s++) {
+          const int i = first + dir*s;
+          double * xi = x + static_cast<size_t>(i)*m;
+          const double * xp = x + static_cast<size_t>(i-dir)*m;
+          const double * ci = c + static_cast<size_t>(i)*m;
+          for (int r = r0; r < r1; r++)
+            xi[r] += ci[r]*xp[r];
+        }
+        if (!cyclic) continue;
+        for (int r = r0; r < r1; r++) {
+          double prod = 1.0;
+          for (int i = 0; i < n && prod != 0.0; i++)
+            prod *= c[static_cast<size_t>(i)*m + r];
+          double carry = x[static_cast<size_t>(last)*m + r] / (1.0 - prod);
+          for (int s = 0; s < n && carry != 0.0; s++) {
+            const size_t ir = static_cast<size_t>(first + dir*s)*m + r;
+            carry *= c[ir];
+            x[ir] += carry;
+          }
+        }
+      }
+    }
+
+    // y_i = x_i - c_i x_i-dir, in place, with x_-1 = x_n-1 (or x_n = x_0) if
+    // cyclic, 0 otherwise
+    void bidiag(double * x, const double * c, const int n, const int m,
+                const int dir, const bool cyclic) {
+      const int first = dir > 0 ? 0 : n-1;
+      const int last = n-1-first;
+      #pragma omp parallel for
+      for (int r0 = 0; r0 < m; r0 += lineBlock) {
+        const int r1 = std::min(m, r0 + lineBlock);
+        double wrap[lineBlock];
+        for (int r = r0; r < r1; r++)
+          wrap[r-r0] = cyclic ? x[static_cast<size_t>(last)*m + r] : 0.0;
+        for (int s = n-1; s > 0; s--) {
+          const int i = first + dir*s;
+          double * xi = x + static_cast<size_t>(i)*m;
+          const double * xp = x + static_cast<size_t>(i-dir)*m;
+          const double * ci = c + static_cast<size_t>(i)*m;
+          for (int r = r0; r < r1; r++)
+            xi[r] -= ci[r]*xp[r];
+        }
+        double * xf = x + static_cast<size_t>(first)*m;
+        const double * cf = c + static_cast<size_t>(first)*m;
+        for (int r = r0; r < r1; r++)
+          xf[r] -= cf[r]*wrap[r-r0];
+      }
+    }
+
+    void scale(double * x, const double * s, const size_t size) {
+      #pragma omp parallel for
+      for (int i = 0; i < static_cast<int>(size); i++)
+        x[i] *= s[i];
+    }
+
+    // per point values of a layout, repeated for nlev interleaved levels
+    const double * perLevel(const std::vector<double> & v, const int nlev,
+                            std::vector<double> & work) {
+      if (nlev == 1) return v.data();
+      work.resize(v.size()*nlev);
+      for (size_t i = 0; i < v.size(); i++)
+        std::fill_n(&work[i*nlev], nlev, v[i]);
+      return work.data();
+    }
+  }  // namespace
+
+// ----------------------------------------------------------------------------
+
+  RecursiveFilter::RecursiveFilter(const Geometry & geom,
+                                   const eckit::Configuration & conf)
+    : comm_(geom.getComm()) {
+    eckit::LocalConfiguration rfConf;
+    conf.get("recursive filter", rfConf);
+    passes_ = rfConf.getInt("passes", 2);
+    normalization_ = rfConf.getString("normalization", "analytic");
+    if (passes_ < 1)
+      util::abor1_cpp("RecursiveFilter::RecursiveFilter(), \"passes\" must "
+                      "be positive", __FILE__, __LINE__);
+    if (!conf.has("correlation lengths"))
+      util::abor1_cpp("RecursiveFilter::RecursiveFilter(), \"correlation "
+                      "lengths\" required", __FILE__, __LINE__);
+
+    const atlas::functionspace::StructuredColumns & fs =
+      *geom.atlasFunctionSpace();
+    const atlas::StructuredGrid & grid = fs.grid();
+    const int nx = static_cast<int>(grid.nxmax());
+    const int ny = static_cast<int>(grid.ny());
+    const int npe = comm_.size(), pe = comm_.rank();
+    nOwned_ = fs.size();
+
+    // blocks of whole rows and whole columns on each PE
+    std::vector<int> rowBegin(npe+1), colBegin(npe+1);
+    for (int p = 0; p <= npe; p++) {
+      rowBegin[p] = static_cast<int>(static_cast<int64_t>(p)*ny/npe);
+      colBegin[p] = static_cast<int>(static_cast<int64_t>(p)*nx/npe);
+    }
+    std::vector<int> rowOwner(ny), colOwner(nx);
+    for (int p = 0; p < npe; p++) {
+      std::fill(&rowOwner[0] + rowBegin[p], &rowOwner[0] + rowBegin[p+1], p);
+      std::fill(&colOwner[0] + colBegin[p], &colOwner[0] + colBegin[p+1], p);
+    }
+    const int j0 = rowBegin[pe], nrows = rowBegin[pe+1] - j0;
+    const int i0 = colBegin[pe], ncols = colBegin[pe+1] - i0;
+
+    // the exchanges between the three layouts
+    std::vector<int> atlasGid(nOwned_), rowsGid(nx*nrows), colsGid(ny*ncols);
+    std::vector<int> row(nOwned_);
+    for (int j = fs.j_begin(); j < fs.j_end(); j++)
+      for (int i = fs.i_begin(j); i < fs.i_end(j); i++) {
+        atlasGid[fs.index(i, j)] = j*nx + i;
+        row[fs.index(i, j)] = j;
+      }
+    for (int i = 0; i < nx; i++)
+      for (int jl = 0; jl < nrows; jl++)
+        rowsGid[i*nrows + jl] = (j0 + jl)*nx + i;
+    for (int j = 0; j < ny; j++)
+      for (int il = 0; il < ncols; il++)
+        colsGid[j*ncols + il] = j*nx + i0 + il;
+
+    auto toRowOwner = [&](int g) { return rowOwner[g / nx]; };
+    auto toColOwner = [&](int g) { return colOwner[g % nx]; };
+    auto toRowPos = [&](int g) { return (g % nx)*nrows + g / nx - j0; };
+    auto toColPos = [&](int g) { return (g / nx)*ncols + g % nx - i0; };
+    makeTranspose(atlasGid, toRowOwner, toRowPos, atlasToRows_);
+    makeTranspose(rowsGid, toColOwner, toColPos, rowsToCols_);
+    makeTranspose(atlasGid, toColOwner, toColPos, atlasToCols_);
+
+    // length scales and mask, in the atlas and row layouts
+    const atlas::Field lengths = correlationLengths(geom, conf);
+    auto lengths_view = make_view<double, 2>(lengths);
+    std::vector<double> lh(nOwned_);
+    mask_.assign(nOwned_, 1.0);
+    for (size_t k = 0; k < nOwned_; k++)
+      lh[k] = lengths_view(k, 0);
+    if (geom.atlasFieldSet()->has_field("gmask")) {
+      auto gmask = make_view<int, 2>(geom.atlasFieldSet()->field("gmask"));
+      for (size_t k = 0; k < nOwned_; k++)
+        mask_[k] = gmask(k, 0) == 0 ? 0.0 : 1.0;
+    }
+    std::vector<double> lhRows(nx*nrows), lhCols(ny*ncols);
+    std::vector<double> maskCols(ny*ncols);
+    maskRows_.resize(nx*nrows);
+    transpose(atlasToRows_, false, lh, lhRows, 1);
+    transpose(atlasToRows_, false, mask_, maskRows_, 1);
+    transpose(atlasToCols_, false, lh, lhCols, 1);
+    transpose(atlasToCols_, false, mask_, maskCols, 1);
+
+    // The sweep coefficients. One sweep pair has a variance of
+    // 2a/(1-a)^2 grid lengths squared, F has P pairs and half of the
+    // variance Lh^2 of C.
+    const double radius = atlas::util::DatumIFS::radius();
+    const double dlon = 2.0 * M_PI / nx;
+    const double dlat = ny > 1 ? std::abs(grid.y(1) - grid.y(0))*M_PI/180.0
+                               : M_PI;
+    auto coef = [this](const double l, const double d, const double mask) {
+      const double v = l*l / (2.0*passes_*d*d);
+      if (mask == 0.0 || v < 1.0e-12) return 0.0;
+      return ((v + 1.0) - std::sqrt(2.0*v + 1.0)) / v;
+    };
+    std::vector<double> aRows(nx*nrows), aCols(ny*ncols);
+    for (int i = 0; i < nx; i++)
+      for (int jl = 0; jl < nrows; jl++) {
+        const int p = i*nrows + jl;
+        const double dx = radius*dlon*std::max(
+          std::cos(grid.y(j0 + jl)*M_PI/180.0), 1.0e-6);
+        aRows[p] = coef(lhRows[p], dx, maskRows_[p]);
+      }
+    for (size_t p = 0; p < aCols.size(); p++)
+      aCols[p] = coef(lhCols[p], radius*dlat, maskCols[p]);
+
+    sweepX_.n = nx;
+    sweepX_.lines = nrows;
+    sweepX_.cyclic = true;
+    makeSweeps(aRows, sweepX_);
+    sweepY_.n = ny;
+    sweepY_.lines = ncols;
+    sweepY_.cyclic = false;
+    makeSweeps(aCols, sweepY_);
+
+    // normalization, land points are left out of the correlation
+    if (normalization_ == "analytic") {
+      std::vector<double> area(nOwned_);
+      for (size_t k = 0; k < nOwned_; k++)
+        area[k] = radius*radius*dlon*dlat*std::max(
+          std::cos(grid.y(row[k])*M_PI/180.0), 1.0e-6);
+      normalizeAnalytic(lh, area);
+    } else if (normalization_ == "randomization") {
+      normalizeRandomized(geom, rfConf.getInt("randomization members", 100),
+                          rfConf.getInt("randomization seed", 1));
+    } else {
+      util::abor1_cpp("RecursiveFilter::RecursiveFilter(), unknown "
+                      "normalization \"" + normalization_ + "\"",
+                      __FILE__, __LINE__);
+    }
+    for (size_t k = 0; k < nOwned_; k++)
+      gamma_[k] *= mask_[k];
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::makeTranspose(
+    const std::vector<int> & srcGid,
+    const std::function<int(int)> & dstOwner,
+    const std::function<int(int)> & dstPos, Transpose & tr) const {
+    const size_t npe = comm_.size();
+    std::vector<std::vector<int>> sendGid(npe), recvGid(npe);
+    tr.send.assign(npe, std::vector<int>());
+    tr.recv.assign(npe, std::vector<int>());
+    for (size_t pos = 0; pos < srcGid.size(); pos++) {
+      const int p = dstOwner(srcGid[pos]);
+      tr.send[p].push_back(pos);
+      sendGid[p].push_back(srcGid[pos]);
+    }
+    comm_.allToAll(sendGid, recvGid);
+    for (size_t p = 0; p < npe; p++)
+      for (const int g : recvGid[p])
+        tr.recv[p].push_back(dstPos(g));
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::transpose(const Transpose & tr, const bool reverse,
+                                  const std::vector<double> & src,
+                                  std::vector<double> & dst,
+                                  const int nlev) const {
+    const std::vector<std::vector<int>> & send = reverse ? tr.recv : tr.send;
+    const std::vector<std::vector<int>> & recv = reverse ? tr.send : tr.recv;
+    const size_t npe = comm_.size();
+    std::vector<std::vector<double>> sendBuf(npe), recvBuf(npe);
+    for (size_t p = 0; p < npe; p++) {
+      sendBuf[p].resize(send[p].size()*nlev);
+      for (size_t n = 0; n < send[p].size(); n++)
+        std::copy_n(&src[static_cast<size_t>(send[p][n])*nlev], nlev,
+                    &sendBuf[p][n*nlev]);
+    }
+    comm_.allToAll(sendBuf, recvBuf);
+    for (size_t p = 0; p < npe; p++)
+      for (size_t n = 0; n < recv[p].size(); n++)
+        std::copy_n(&recvBuf[p][n*nlev], nlev,
+                    &dst[static_cast<size_t>(recv[p][n])*nlev]);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::makeSweeps(const std::vector<double> & a,
+                                   Sweeps & sw) const {
+    const int n = sw.n, m = sw.lines;
+    sw.a = a;
+    sw.aNext.assign(a.size(), 0.0);
+    sw.aPrev.assign(a.size(), 0.0);
+    sw.oneMinus.resize(a.size());
+    sw.invOneMinus.resize(a.size());
+    for (int i = 0; i < n; i++)
+      for (int r = 0; r < m; r++) {
+        const size_t p = static_cast<size_t>(i)*m + r;
+        if (i < n-1 || sw.cyclic)
+          sw.aNext[p] = a[static_cast<size_t>((i+1) % n)*m + r];
+        if (i > 0 || sw.cyclic)
+          sw.aPrev[p] = a[static_cast<size_t>((i+n-1) % n)*m + r];
+        sw.oneMinus[p] = 1.0 - a[p];
+        sw.invOneMinus[p] = 1.0 / (1.0 - a[p]);
+      }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::filter(const Sweeps & sw, std::vector<double> & x,
+                               const int nlev) const {
+    // (Sb Sf)^P,  Sf = Lf^-1 D,  Sb = Lb^-1 D
+    std::vector<double> w1, w2;
+    const double * a = perLevel(sw.a, nlev, w1);
+    const double * om = perLevel(sw.oneMinus, nlev, w2);
+    const int m = sw.lines*nlev;
+    for (int p = 0; p < passes_; p++) {
+      scale(x.data(), om, x.size());
+      recurse(x.data(), a, sw.n, m, 1, sw.cyclic);
+      scale(x.data(), om, x.size());
+      recurse(x.data(), a, sw.n, m, -1, sw.cyclic);
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::filterAD(const Sweeps & sw, std::vector<double> & x,
+                                 const int nlev) const {
+    // (Sf^T Sb^T)^P,  Sf^T = D Lf^-T,  Sb^T = D Lb^-T
+    std::vector<double> w1, w2, w3;
+    const double * aNext = perLevel(sw.aNext, nlev, w1);
+    const double * aPrev = perLevel(sw.aPrev, nlev, w2);
+    const double * om = perLevel(sw.oneMinus, nlev, w3);
+    const int m = sw.lines*nlev;
+    for (int p = 0; p < passes_; p++) {
+      recurse(x.data(), aPrev, sw.n, m, 1, sw.cyclic);
+      scale(x.data(), om, x.size());
+      recurse(x.data(), aNext, sw.n, m, -1, sw.cyclic);
+      scale(x.data(), om, x.size());
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::filterInverse(const Sweeps & sw,
+                                      std::vector<double> & x,
+                                      const int nlev) const {
+    // (Sf^-1 Sb^-1)^P,  Sf^-1 = D^-1 Lf,  Sb^-1 = D^-1 Lb
+    std::vector<double> w1, w2;
+    const double * a = perLevel(sw.a, nlev, w1);
+    const double * iom = perLevel(sw.invOneMinus, nlev, w2);
+    const int m = sw.lines*nlev;
+    for (int p = 0; p < passes_; p++) {
+      bidiag(x.data(), a, sw.n, m, -1, sw.cyclic);
+      scale(x.data(), iom, x.size());
+      bidiag(x.data(), a, sw.n, m, 1, sw.cyclic);
+      scale(x.data(), iom, x.size());
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::filterInverseAD(const Sweeps & sw,
+                                        std::vector<double> & x,
+                                        const int nlev) const {
+    // (Sb^-T Sf^-T)^P,  Sf^-T = Lf^T D^-1,  Sb^-T = Lb^T D^-1
+    std::vector<double> w1, w2, w3;
+    const double * aNext = perLevel(sw.aNext, nlev, w1);
+    const double * aPrev = perLevel(sw.aPrev, nlev, w2);
+    const double * iom = perLevel(sw.invOneMinus, nlev, w3);
+    const int m = sw.lines*nlev;
+    for (int p = 0; p < passes_; p++) {
+      scale(x.data(), iom, x.size());
+      bidiag(x.data(), aNext, sw.n, m, -1, sw.cyclic);
+      scale(x.data(), iom, x.size());
+      bidiag(x.data(), aPrev, sw.n, m, 1, sw.cyclic);
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::applySqrt(std::vector<double> & x,
+                                  const int nlev) const {
+    std::vector<double> rows(maskRows_.size()*nlev);
+    std::vector<double> cols(sweepY_.a.size()*nlev);
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        x[k*nlev+l] = mask_[k] == 0.0 ? 0.0 : x[k*nlev+l];
+    transpose(atlasToRows_, false, x, rows, nlev);
+    filter(sweepX_, rows, nlev);
+    transpose(rowsToCols_, false, rows, cols, nlev);
+    filter(sweepY_, cols, nlev);
+    transpose(atlasToCols_, true, cols, x, nlev);
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        x[k*nlev+l] *= gamma_[k];
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::normalizeAnalytic(const std::vector<double> & lh,
+                                          const std::vector<double> & area) {
+    // For a gaussian F of variance s^2 (in grid lengths) in each direction,
+    // the diagonal of F F^T is 1/(4 pi sx sy), with s^2 = Lh^2/(2 d^2).
+    // Lengths shorter than the grid spacing tend to the identity, G = 1.
+    gamma_.resize(nOwned_);
+    for (size_t k = 0; k < nOwned_; k++)
+      gamma_[k] = std::sqrt(std::max(2.0*M_PI*lh[k]*lh[k]/area[k], 1.0));
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::normalizeRandomized(const Geometry & geom,
+                                            const int members,
+                                            const size_t seed) {
+    // var(U x) for x ~ N(0, I) is the diagonal of U U^T, estimated with all
+    // the members at once by using them as the levels of one field
+    auto gidx = make_view<atlas::gidx_t, 1>(
+      geom.atlasFunctionSpace()->global_index());
+    const Philox rng(seed);
+    std::vector<double> x(nOwned_*members);
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int m = 0; m < members; m++)
+        x[k*members+m] = rng.normal(gidx(k), 0, 0, m);
+
+    gamma_.assign(nOwned_, 1.0);
+    applySqrt(x, members);
+
+    for (size_t k = 0; k < nOwned_; k++) {
+      double var = 0.0;
+      for (int m = 0; m < members; m++)
+        var += x[k*members+m]*x[k*members+m];
+      var /= members;
+      gamma_[k] = var > 0.0 ? 1.0/std::sqrt(var) : 0.0;
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::multiply(atlas::FieldSet & fset) const {
+    util::Timer timer("umdsst::RecursiveFilter", "multiply");
+    std::vector<double> x;
+    const int nlev = packLevels(fset, x);
+    std::vector<double> rows(maskRows_.size()*nlev);
+    std::vector<double> cols(sweepY_.a.size()*nlev);
+
+    // U^T
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        x[k*nlev+l] = gamma_[k] == 0.0 ? 0.0 : gamma_[k]*x[k*nlev+l];
+    transpose(atlasToCols_, false, x, cols, nlev);
+    filterAD(sweepY_, cols, nlev);
+    transpose(rowsToCols_, true, cols, rows, nlev);
+    filterAD(sweepX_, rows, nlev);
+
+    // M, then U
+    for (size_t p = 0; p < maskRows_.size(); p++)
+      for (int l = 0; l < nlev; l++)
+        rows[p*nlev+l] *= maskRows_[p];
+    filter(sweepX_, rows, nlev);
+    transpose(rowsToCols_, false, rows, cols, nlev);
+    filter(sweepY_, cols, nlev);
+    transpose(atlasToCols_, true, cols, x, nlev);
+
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        x[k*nlev+l] *= gamma_[k];
+    unpackLevels(x, fset);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::sqrtMultiply(atlas::FieldSet & fset) const {
+    std::vector<double> x;
+    const int nlev = packLevels(fset, x);
+    applySqrt(x, nlev);
+    unpackLevels(x, fset);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::inverseMultiply(atlas::FieldSet & fset) const {
+    // G^-1 Fy^-T Fx^-T M Fx^-1 Fy^-1 G^-1, which is the inverse of C for the
+    // ocean points since F does not map ocean points to land points
+    util::Timer timer("umdsst::RecursiveFilter", "inverseMultiply");
+    std::vector<double> x;
+    const int nlev = packLevels(fset, x);
+    std::vector<double> rows(maskRows_.size()*nlev);
+    std::vector<double> cols(sweepY_.a.size()*nlev);
+
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        x[k*nlev+l] = gamma_[k] == 0.0 ? 0.0 : x[k*nlev+l]/gamma_[k];
+    transpose(atlasToCols_, false, x, cols, nlev);
+    filterInverse(sweepY_, cols, nlev);
+    transpose(rowsToCols_, true, cols, rows, nlev);
+    filterInverse(sweepX_, rows, nlev);
+    for (size_t p = 0; p < maskRows_.size(); p++)
+      for (int l = 0; l < nlev; l++)
+        rows[p*nlev+l] *= maskRows_[p];
+    filterInverseAD(sweepX_, rows, nlev);
+    transpose(rowsToCols_, false, rows, cols, nlev);
+    filterInverseAD(sweepY_, cols, nlev);
+    transpose(atlasToCols_, true, cols, x, nlev);
+
+    for (size_t k = 0; k < nOwned_; k++)
+      for (int l = 0; l < nlev; l++)
+        x[k*nlev+l] = gamma_[k] == 0.0 ? 0.0 : x[k*nlev+l]/gamma_[k];
+    unpackLevels(x, fset);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void RecursiveFilter::print(std::ostream & os) const {
+    os << "RecursiveFilter: " << passes_ << " passes, " << normalization_
+       << " normalization";
+  }
+
+// ----------------------------------------------------------------------------
+
+}  // namespace umdsst
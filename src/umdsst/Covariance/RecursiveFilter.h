@@ -0,0 +1,119 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_COVARIANCE_RECURSIVEFILTER_H_
+#define UMDSST_COVARIANCE_RECURSIVEFILTER_H_
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "umdsst/Covariance/CorrelationBase.h"
+
+// forward declarations
+namespace eckit {
+  namespace mpi {
+    class Comm;
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+namespace umdsst {
+
+  // Correlation operator given by a separable first order recursive filter
+  // (Lorenc, 1992; Purser et al., 2003):
+  //
+  //   C = U U^T,   U = G Fy Fx M,   F = (Sb Sf)^P
+  //
+  // Sf and Sb are forward and backward sweeps y_i = a_i y_i-1 + (1-a_i) x_i
+  // along grid lines, with the coefficients a_i given by the length scale at
+  // each point, G is the normalization and M the ocean mask. Land points
+  // have a = 0, which stops the sweeps. The x sweeps are periodic.
+  //
+  // The sweeps along x run on whole rows and the sweeps along y on whole
+  // columns, the fields are transposed between the atlas partitioning and
+  // these layouts with all-to-all exchanges. In both layouts the lines are
+  // interleaved (the point along the line is the slowest index), so that
+  // each step of a sweep is a vector operation over all the local lines.
+  // The inverse of each sweep is a bidiagonal product, so C^-1 is as cheap
+  // as C.
+  class RecursiveFilter : public CorrelationBase {
+   public:
+    RecursiveFilter(const Geometry &, const eckit::Configuration &);
+    ~RecursiveFilter() {}
+
+    void multiply(atlas::FieldSet &) const override;
+
+    bool hasInverse() const override { return true; }
+    void inverseMultiply(atlas::FieldSet &) const override;
+
+    bool hasSqrt() const override { return true; }
+    void sqrtMultiply(atlas::FieldSet &) const override;
+
+   private:
+    void print(std::ostream &) const override;
+
+    // the coefficients of the sweeps of one direction, a_i, a_i+1, a_i-1,
+    // 1-a_i and 1/(1-a_i) at each point of its layout
+    struct Sweeps {
+      int n;         // points along a line
+      int lines;     // local lines
+      bool cyclic;
+      std::vector<double> a, aNext, aPrev, oneMinus, invOneMinus;
+    };
+
+    // local positions to send to / receive from each PE to go from one
+    // layout to another. The reverse exchange swaps the two.
+    struct Transpose {
+      std::vector<std::vector<int>> send;
+      std::vector<std::vector<int>> recv;
+    };
+
+    // from the global index (j*nx + i) at each local position of the source
+    // layout, the PE and the position in the destination layout
+    void makeTranspose(const std::vector<int> &,
+                       const std::function<int(int)> &,
+                       const std::function<int(int)> &, Transpose &) const;
+    void transpose(const Transpose &, const bool,
+                   const std::vector<double> &, std::vector<double> &,
+                   const int) const;
+    void makeSweeps(const std::vector<double> &, Sweeps &) const;
+
+    // F, F^T, F^-1 and F^-T of one direction, in place
+    void filter(const Sweeps &, std::vector<double> &, const int) const;
+    void filterAD(const Sweeps &, std::vector<double> &, const int) const;
+    void filterInverse(const Sweeps &, std::vector<double> &,
+                       const int) const;
+    void filterInverseAD(const Sweeps &, std::vector<double> &,
+                         const int) const;
+
+    // U x, with x in the atlas layout, as nlev interleaved fields
+    void applySqrt(std::vector<double> &, const int) const;
+
+    void normalizeAnalytic(const std::vector<double> &,
+                           const std::vector<double> &);
+    void normalizeRandomized(const Geometry &, const int, const size_t);
+
+    const eckit::mpi::Comm & comm_;
+    int passes_;
+    std::string normalization_;
+
+    // atlas layout <-> rows (x sweeps) <-> columns (y sweeps)
+    size_t nOwned_;
+    Transpose atlasToRows_, rowsToCols_, atlasToCols_;
+    Sweeps sweepX_, sweepY_;
+
+    // ocean mask (1 or 0) in the atlas and row layouts, and G
+    std::vector<double> mask_, maskRows_;
+    std::vector<double> gamma_;
+  };
+
+}  // namespace umdsst
+
+#endif  // UMDSST_COVARIANCE_RECURSIVEFILTER_H_
@@ -5,8 +5,12 @@
  * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
  */
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "netcdf"
 
@@ -37,93 +41,148 @@ namespace umdsst {
     //  and Increment constructors ultimately end up here)
 
     atlasFieldSet_.reset(new atlas::FieldSet());
-    for (int v = 0; v < vars_.size(); v++) {
+    for (size_t v = 0; v < vars_.size(); v++) {
       std::string var = vars_[v];
       atlas::Field fld = geom_->atlasFunctionSpace()->createField<double>(
-                         atlas::option::levels(1) |
+                         atlas::option::levels(geom_->levels(var)) |
                          atlas::option::name(var));
       auto fd = make_view<double, 2>(fld);
       fd.assign(0.0);
 
       atlasFieldSet_->add(fld);
     }
+    cacheFieldData();
   }
 
 // ----------------------------------------------------------------------------
 
-  Fields::Fields(const Fields & other)
-    : Fields(*other.geom_, other.vars_, other.time_) {
-    // copy data from object other
-    *this = other;
+  Fields::Fields(const Fields & other, const bool copy)
+    : geom_(other.geom_), missing_(other.missing_), time_(other.time_),
+      vars_(other.vars_) {
+    // The geometry is immutable, so it is shared instead of rebuilt, and the
+    // fields are allocated and filled in a single pass.
+    atlasFieldSet_.reset(new atlas::FieldSet());
+    for (size_t v = 0; v < vars_.size(); v++) {
+      std::string var = vars_[v];
+      atlas::Field fld = geom_->atlasFunctionSpace()->createField<double>(
+                         atlas::option::levels(geom_->levels(var)) |
+                         atlas::option::name(var));
+      auto fd = make_view<double, 2>(fld);
+      if (copy) {
+        std::copy(other.fieldData_[v],
+                  other.fieldData_[v] + other.fieldSize_[v], fd.data());
+      } else {
+        fd.assign(0.0);
+      }
+
+      atlasFieldSet_->add(fld);
+    }
+    cacheFieldData();
   }
 
 // ----------------------------------------------------------------------------
-  Fields & Fields::operator =(const Fields & other) {
-    const int size = geom_->atlasFunctionSpace()->size();
-
-    for (int v = 0; v < vars_.size(); v++) {
-      std::string name = vars_[v];
-      auto fd       = make_view<double, 2>(atlasFieldSet_->field(name));
-      auto fd_other = make_view<double, 2>(other.atlasFieldSet_->field(name));
-      for (int j = 0; j < size; j++)
-        fd(j, 0) = fd_other(j, 0);
+
+  Fields::Fields(Fields && other)
+    : atlasFieldSet_(std::move(other.atlasFieldSet_)),
+      geom_(std::move(other.geom_)), missing_(other.missing_),
+      time_(other.time_), vars_(other.vars_),
+      fieldData_(std::move(other.fieldData_)),
+      fieldSize_(std::move(other.fieldSize_)),
+      fieldLevels_(std::move(other.fieldLevels_)) {
+    // steal the FieldSet from other, no data is copied.
+  }
+
+// ----------------------------------------------------------------------------
+
+  void Fields::cacheFieldData() {
+    fieldData_.clear();
+    fieldSize_.clear();
+    fieldLevels_.clear();
+    for (size_t v = 0; v < vars_.size(); v++) {
+      atlas::Field fld = atlasFieldSet_->field(vars_[v]);
+      auto fd = make_view<double, 2>(fld);
+      fieldData_.push_back(fd.data());
+      fieldSize_.push_back(fd.size());
+      fieldLevels_.push_back(fld.levels());
     }
+  }
+
+// ----------------------------------------------------------------------------
+
+  size_t Fields::varIndex(const std::string & var) const {
+    for (size_t v = 0; v < vars_.size(); v++)
+      if (vars_[v] == var)
+        return v;
+    util::abor1_cpp("Fields::varIndex(), unknown variable " + var,
+                    __FILE__, __LINE__);
+    return 0;
+  }
+
+// ----------------------------------------------------------------------------
+
+  Fields & Fields::operator =(const Fields & other) {
+    if (this == &other)
+      return *this;
+
+    binaryOp(other, [](double & x, const double & y) { x = y; });
     return *this;
   }
 
 // ----------------------------------------------------------------------------
 
-  Fields & Fields::operator+=(const Fields &other) {
-    const int size = geom_->atlasFunctionSpace()->size();
+  Fields & Fields::operator =(Fields && other) {
+    if (this == &other)
+      return *this;
+
+    // steal the FieldSet from other, no data is copied.
+    atlasFieldSet_ = std::move(other.atlasFieldSet_);
+    geom_ = std::move(other.geom_);
+    time_ = other.time_;
+    vars_ = other.vars_;
+    fieldData_ = std::move(other.fieldData_);
+    fieldSize_ = std::move(other.fieldSize_);
+    fieldLevels_ = std::move(other.fieldLevels_);
+    return *this;
+  }
 
-    for (int v = 0; v < vars_.size(); v++) {
-      std::string name = vars_[v];
-      auto fd       = make_view<double, 2>(atlasFieldSet_->field(name));
-      auto fd_other = make_view<double, 2>(other.atlasFieldSet_->field(name));
+// ----------------------------------------------------------------------------
 
-      for (int j = 0; j < size; j++) {
-        if (fd(j, 0) == missing_ || fd_other(j, 0) == other.missing_)
-          fd(j, 0) = missing_;
+  Fields & Fields::operator+=(const Fields &other) {
+    const double missing = missing_;
+    const double missing_other = other.missing_;
+    binaryOp(other, [missing, missing_other](double & x, const double & y) {
+        if (x == missing || y == missing_other)
+          x = missing;
         else
-          fd(j, 0) += fd_other(j, 0);
-      }
-    }
+          x += y;
+      });
     return *this;
   }
 
 // ----------------------------------------------------------------------------
 
   void Fields::accumul(const double &zz, const Fields &rhs) {
-    const size_t size = geom_->atlasFunctionSpace()->size();
-
-    for (int v = 0; v < vars_.size(); v++) {
-      std::string name = vars_[v];
-      auto fd = make_view<double, 2>(atlasFieldSet_->field(name));
-      auto fd_rhs = make_view<double, 2>(rhs.atlasFieldSet()->field(name));
-
-      for (size_t i = 0; i < size; i++) {
-        if (fd(i, 0) == missing_ || fd_rhs(i, 0) == missing_)
-          fd(i, 0) = missing_;
+    const double missing = missing_;
+    binaryOp(rhs, [missing, zz](double & x, const double & y) {
+        if (x == missing || y == missing)
+          x = missing;
         else
-          fd(i, 0) +=  zz*fd_rhs(i, 0);
-      }
-    }
+          x += zz*y;
+      });
   }
 
 // ----------------------------------------------------------------------------
 
   double Fields::norm() const {
-    const int size = geom_->atlasFunctionSpace()->size();
     int nValid = 0;
     double norm = 0.0, s = 0.0;
 
-    for (int v = 0; v < vars_.size(); v++) {
-      auto fd = make_view<double, 2>(atlasFieldSet_->field(v));
-
-      for (int i = 0; i < size; i++) {
-        if (fd(i, 0) != missing_) {
+    for (size_t v = 0; v < fieldData_.size(); v++) {
+      const double * x = fieldData_[v];
+      for (size_t i = 0; i < fieldSize_[v]; i++) {
+        if (x[i] != missing_) {
           nValid += 1;
-          s += fd(i, 0)*fd(i, 0);
+          s += x[i]*x[i];
         }
       }
     }
@@ -143,11 +202,8 @@ namespace umdsst {
 // ----------------------------------------------------------------------------
 
   void Fields::zero() {
-    const int size = geom_->atlasFunctionSpace()->size();
-    for (int v = 0; v < vars_.size(); v++) {
-      auto fd = make_view<double, 2>(atlasFieldSet_->field(v));
-      fd.assign(0.0);
-    }
+    for (size_t v = 0; v < fieldData_.size(); v++)
+      std::fill(fieldData_[v], fieldData_[v] + fieldSize_[v], 0.0);
   }
 
 // ----------------------------------------------------------------------------
@@ -158,7 +214,14 @@ namespace umdsst {
     atlas::Field globalSst = geom_->atlasFunctionSpace()->createField<double>(
                          atlas::option::levels(1) |
                          atlas::option::global());
+    readGlobal(conf, globalSst);
+    fromGlobal(globalSst);
+  }
+
+// ----------------------------------------------------------------------------
 
+  void Fields::readGlobal(const eckit::Configuration & conf,
+                          atlas::Field & globalSst) const {
     // following code block should execute on the root PE only
     // Ligang: How do you do to decide which PEs to run with Atlas?
     // Check the above Fields::norm() which sums results across PEs.
@@ -166,7 +229,7 @@ namespace umdsst {
       int time = 0, lon = 0, lat = 0;
       std::string filename;
 
-      auto fd = make_view<double, 2>(globalSst);
+      double * fd = make_view<double, 2>(globalSst).data();
 
       // get filename
       if (!conf.get("filename", filename))
@@ -191,38 +254,40 @@ namespace umdsst {
           __FILE__, __LINE__);
       }
 
-      // get sst data
+      // get sst data, on the heap since this can run on a thread with a
+      // small stack
       netCDF::NcVar sstVar;
       sstVar = file.getVar("sst");
       if (sstVar.isNull())
         util::abor1_cpp("Get sst var failed.", __FILE__, __LINE__);
-      float  sstData[lat][lon];
-      sstVar.getVar(sstData);  // if used double, read-in data would be wrong.
+      std::vector<float> sstData(lat*lon);
+      // if used double, read-in data would be wrong.
+      sstVar.getVar(sstData.data());
 
-      // mask missing values
+      // mask missing values, float to double
       const double epsilon = 1.0e-6;
       const double missing_nc = -32768.0;
       bool isKelvin = conf.getBool("kelvin", false);
-      for (int j = 0; j < lat; j++)
-        for (int i = 0; i < lon; i++)
-          if (abs(sstData[j][i]-(missing_nc)) < epsilon) {
-            sstData[j][i] = missing_;
+      int idx = 0;
+      for (int j = lat-1; j >= 0; j--)
+        for (int i = 0; i < lon; i++) {
+          const double x = static_cast<double>(sstData[j*lon + i]);
+          if (std::abs(x - missing_nc) < epsilon) {
+            fd[idx++] = missing_;
             // TODO(someone) missing values that aren't a part of the landmask
             // should be filled in instead
           } else {
             // Kelvin to Celsius which JEDI use internally, will check if the
             // units is Kelvin or Celsius in the future
-            if (isKelvin)
-              sstData[j][i] -= 273.15;
+            fd[idx++] = isKelvin ? x - 273.15 : x;
           }
-
-      // float to double
-      int idx = 0;
-      for (int j = lat-1; j >= 0; j--)
-        for (int i = 0; i < lon; i++)
-          fd(idx++, 0) = static_cast<double>(sstData[j][i]);
+        }
     }
+  }
+
+// ----------------------------------------------------------------------------
 
+  void Fields::fromGlobal(const atlas::Field & globalSst) {
     // scatter to the PEs
     geom_->atlasFunctionSpace()->scatter(
       globalSst, atlasFieldSet_->field("sea_surface_temperature"));
@@ -230,12 +295,13 @@ namespace umdsst {
     // apply mask from read in landmask
     if ( (*geom_->atlasFieldSet()).has_field("gmask") ) {
        atlas::Field mask_field = (*geom_->atlasFieldSet())["gmask"];
-       auto mask = make_view<int, 2>(mask_field);
-       auto fd = make_view<double, 2>(atlasFieldSet_->field(0));
-       for (int i = 0; i < mask.size(); i++) {
-         if (mask(i, 0) == 0)
-           fd(i, 0) = missing_;
-       }
+       const int * mask = make_view<int, 2>(mask_field).data();
+       const double missing = missing_;
+       columnOp(varIndex("sea_surface_temperature"),
+                [mask, missing](double & x, size_t j) {
+                  if (mask[j] == 0)
+                    x = missing;
+                });
      }
   }
 
@@ -307,21 +373,21 @@ namespace umdsst {
       sstVar.putAtt("missing_value", netCDF::NcFloat(), fillvalue);
 
       // write data to the file
-      auto fd = make_view<double, 2>(globalSst);
+      const double * fd = make_view<double, 2>(globalSst).data();
       float sstData[time][lat][lon];
       bool isKelvin = conf.getBool("kelvin", false);
       int idx = 0;
       for (int j = lat-1; j >= 0; j--)
         for (int i = 0; i < lon; i++) {
-          if (fd(idx, 0) == missing_) {
+          if (fd[idx] == missing_) {
             sstData[0][j][i] = fillvalue;
           } else {
             // doulbe to float, also convert JEDI Celsius to Kelvin, in the
             // future it should be able to handle both Kelvin and Celsius.
             if (isKelvin)
-              sstData[0][j][i] = static_cast<float>(fd(idx, 0)) + 273.15;
+              sstData[0][j][i] = static_cast<float>(fd[idx]) + 273.15;
             else
-              sstData[0][j][i] = static_cast<float>(fd(idx, 0));
+              sstData[0][j][i] = static_cast<float>(fd[idx]);
           }
           idx++;
         }
@@ -348,7 +414,7 @@ namespace umdsst {
 // ----------------------------------------------------------------------------
 
   void Fields::setAtlas(atlas::FieldSet * fs) const {
-    for (int v = 0; v < vars_.size(); v++) {
+    for (size_t v = 0; v < vars_.size(); v++) {
       fs->add((*atlasFieldSet_)[v]);
     }
   }
@@ -356,61 +422,52 @@ namespace umdsst {
 // ----------------------------------------------------------------------------
 
   void Fields::toAtlas(atlas::FieldSet * fs_to) const {
-    const int size = geom_->atlasFunctionSpace()->size();
-
     // Ligang: you will have segment fault with following delete/new code.
     // if (fs_to)
     //   delete fs_to;
     // fs_to = new atlas::FieldSet();
 
-    for (int i = 0; i < vars_.size(); i++) {
+    for (size_t i = 0; i < vars_.size(); i++) {
       std::string var_name = vars_[i];
       if (!fs_to->has_field(var_name)) {
         atlas::Field fld_to = geom_->atlasFunctionSpace()->createField<double>(
-                 atlas::option::levels(1) |
+                 atlas::option::levels(fieldLevels_[i]) |
                  atlas::option::name(var_name));
         fs_to->add(fld_to);
       }
       auto fd_to = make_view<double, 2>(fs_to->field(var_name));
-
-      auto fd    = make_view<double, 2>(atlasFieldSet_->field(var_name));
-      for (int j = 0; j < size; j++)
-        fd_to(j, 0) = fd(j, 0);
+      std::copy(fieldData_[i], fieldData_[i] + fieldSize_[i], fd_to.data());
     }
   }
 
 // ----------------------------------------------------------------------------
 
   void Fields::fromAtlas(atlas::FieldSet * fs_from) {
-    const int size = geom_->atlasFunctionSpace()->size();
-
-    for (int i = 0; i < vars_.size(); i++) {
+    for (size_t i = 0; i < vars_.size(); i++) {
       std::string var_name = vars_[i];
 
-      auto fd      = make_view<double, 2>(atlasFieldSet_->field(var_name));
       auto fd_from = make_view<double, 2>(fs_from->field(var_name));
-      for (int j = 0; j < size; j++)
-        fd(j, 0) = fd_from(j, 0);
+      std::copy(fd_from.data(), fd_from.data() + fieldSize_[i],
+                fieldData_[i]);
     }
   }
 
 // ----------------------------------------------------------------------------
 
   void Fields::print(std::ostream & os) const {
-    const int size = geom_->atlasFunctionSpace()->size();
-    for (int v = 0; v < vars_.size(); v++) {
-      auto fd = make_view<double, 2>(atlasFieldSet_->field(v));
+    for (size_t v = 0; v < vars_.size(); v++) {
+      const double * fd = fieldData_[v];
       double mean = 0.0, sum = 0.0,
             min = std::numeric_limits<double>::max(),
             max = std::numeric_limits<double>::min();
       int nValid = 0;
 
-      for (int i = 0; i < size; i++)
-        if (fd(i, 0) != missing_) {
-          if (fd(i, 0) < min) min = fd(i, 0);
-          if (fd(i, 0) > max) max = fd(i, 0);
+      for (size_t i = 0; i < fieldSize_[v]; i++)
+        if (fd[i] != missing_) {
+          if (fd[i] < min) min = fd[i];
+          if (fd[i] > max) max = fd[i];
 
-          sum += fd(i, 0);
+          sum += fd[i];
           nValid++;
         }
 
@@ -9,6 +9,7 @@
 #define UMDSST_FIELDS_FIELDS_H_
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "atlas/field.h"
@@ -38,11 +39,13 @@ namespace umdsst {
     // Constructors/destructors
     Fields(const Geometry & , const oops::Variables & ,
            const util::DateTime &);
-    Fields(const Fields &);
+    Fields(const Fields &, const bool copy = true);
+    Fields(Fields &&);
     ~Fields() {}
 
     // math operators
     Fields & operator =(const Fields &);
+    Fields & operator =(Fields &&);
     Fields & operator+=(const Fields &);
     void accumul(const double &, const Fields &);
     double norm() const;
@@ -55,6 +58,12 @@ namespace umdsst {
 
     // I/O
     void read(const eckit::Configuration &);
+    // the two halves of read: the file is read into a global field on the
+    // root PE, without any communication so that it can run on a separate
+    // thread (e.g. to read the next file while this one is processed), and
+    // is then scattered and masked
+    void readGlobal(const eckit::Configuration &, atlas::Field &) const;
+    void fromGlobal(const atlas::Field &);
     void write(const eckit::Configuration &) const;
 
     // Serialization (not needed by our project)
@@ -66,6 +75,9 @@ namespace umdsst {
     std::shared_ptr<atlas::FieldSet> atlasFieldSet() const;
     std::shared_ptr<const Geometry> geometry() const;
     const oops::Variables & variables() const { return vars_; }
+    const double * fieldData(const std::string & var) const {
+      return fieldData_[varIndex(var)];
+    }
 
     // Ligang: 20210111, adjust for JEDI rep updates
     void setAtlas(atlas::FieldSet *) const;
@@ -73,13 +85,75 @@ namespace umdsst {
     void fromAtlas(atlas::FieldSet *);
 
    protected:
+    // resolve the index of a variable in vars_ by name
+    size_t varIndex(const std::string &) const;
+
+    // apply op(x) to every value of every variable. The data of each field
+    // is contiguous over columns and levels, so the same flat loop serves
+    // single and multi-level fields.
+    template <typename OP>
+    void unaryOp(OP op) {
+      for (size_t v = 0; v < fieldData_.size(); v++) {
+        double * x = fieldData_[v];
+        for (size_t i = 0; i < fieldSize_[v]; i++)
+          op(x[i]);
+      }
+    }
+
+    // apply op(x, y) to every value of every variable, the variables of
+    // "other" are matched by name
+    template <typename OP>
+    void binaryOp(const Fields & other, OP op) {
+      for (size_t v = 0; v < fieldData_.size(); v++) {
+        double * x = fieldData_[v];
+        const double * y = (v < other.vars_.size() &&
+                            other.vars_[v] == vars_[v]) ?
+                           other.fieldData_[v] : other.fieldData(vars_[v]);
+        for (size_t i = 0; i < fieldSize_[v]; i++)
+          op(x[i], y[i]);
+      }
+    }
+
+    // apply op(x, j) to every value x of variable v, where j is the index of
+    // the horizontal column x belongs to. Dispatched on the number of
+    // levels, so the single level (2D) case has a compile-time stride.
+    template <typename OP>
+    void columnOp(size_t v, OP op) {
+      switch (fieldLevels_[v]) {
+        case 1:
+          columnLoop<1>(v, op);
+          break;
+        default:
+          columnLoop<0>(v, op);
+      }
+    }
+
     std::shared_ptr<atlas::FieldSet> atlasFieldSet_;
     std::shared_ptr<const Geometry> geom_;
     const double missing_;
     util::DateTime time_;
     oops::Variables vars_;
 
+    // pre-resolved, contiguous data of each field in atlasFieldSet_, in the
+    // same order as vars_, so that the math operators do not have to look up
+    // the fields by name or create new views on every call.
+    std::vector<double *> fieldData_;
+    std::vector<size_t> fieldSize_;
+    std::vector<int> fieldLevels_;
+
    private:
+    // NLEV == 0 means the number of levels is only known at run time
+    template <int NLEV, typename OP>
+    void columnLoop(size_t v, OP op) {
+      const size_t nlev = NLEV > 0 ? NLEV : fieldLevels_[v];
+      const size_t ncol = fieldSize_[v] / nlev;
+      double * x = fieldData_[v];
+      for (size_t j = 0; j < ncol; j++)
+        for (size_t k = 0; k < nlev; k++)
+          op(x[j*nlev + k], j);
+    }
+
+    void cacheFieldData();
     void print(std::ostream &) const override;
   };
 }  // namespace umdsst
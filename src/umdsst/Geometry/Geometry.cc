@@ -6,6 +6,7 @@
  */
 
 #include <fstream>
+#include <string>
 #include <vector>
 #include "netcdf"
 
@@ -13,6 +14,7 @@
 
 #include "eckit/container/KDTree.h"
 #include "eckit/config/Configuration.h"
+#include "eckit/config/LocalConfiguration.h"
 
 #include "atlas/grid.h"
 #include "atlas/array.h"
@@ -69,11 +71,20 @@ namespace umdsst {
     if (conf.has("rossby radius file")) {
       readRossbyRadius(conf.getString("rossby radius file"));
     }
+
+    // number of levels for any multi-level variables (e.g. a subsurface
+    // temperature profile), everything else is a single level 2D field
+    if (conf.has("levels")) {
+      eckit::LocalConfiguration levelsConf(conf, "levels");
+      for (const std::string & var : levelsConf.keys())
+        levels_[var] = levelsConf.getInt(var);
+    }
   }
 
 // ----------------------------------------------------------------------------
 
-  Geometry::Geometry(const Geometry & other) : comm_(other.comm_) {
+  Geometry::Geometry(const Geometry & other)
+    : comm_(other.comm_), levels_(other.levels_) {
     atlasFunctionSpace_.reset(new
       atlas::functionspace::StructuredColumns(other.atlasFunctionSpace_->grid(),
       atlas::option::halo(0)));
@@ -89,6 +100,49 @@ namespace umdsst {
 
   Geometry::~Geometry() {}
 
+// ----------------------------------------------------------------------------
+
+  int Geometry::levels(const std::string & var) const {
+    auto it = levels_.find(var);
+    return it == levels_.end() ? 1 : it->second;
+  }
+
+// ----------------------------------------------------------------------------
+
+  atlas::functionspace::StructuredColumns*
+    Geometry::atlasFunctionSpaceHalo() const {
+    // the default partitioner is deterministic, so the owned points are the
+    // same as those of atlasFunctionSpace_
+    if (!atlasFunctionSpaceHalo_) {
+      atlasFunctionSpaceHalo_.reset(
+        new atlas::functionspace::StructuredColumns(
+          atlasFunctionSpace_->grid(), atlas::option::halo(1)));
+    }
+    return atlasFunctionSpaceHalo_.get();
+  }
+
+// ----------------------------------------------------------------------------
+
+  int Geometry::localIndex(const int i, const int j) const {
+    // The points owned by a PE of a StructuredColumns are a range of rows,
+    // each with a contiguous range of columns, so ownership can be checked
+    // arithmetically and no search over the global indices is needed.
+    const atlas::functionspace::StructuredColumns & fs = *atlasFunctionSpace_;
+    if (j < fs.j_begin() || j >= fs.j_end() ||
+        i < fs.i_begin(j) || i >= fs.i_end(j))
+      return -1;
+    return fs.index(i, j);
+  }
+
+// ----------------------------------------------------------------------------
+
+  int Geometry::localIndex(const atlas::gidx_t gidx) const {
+    const int nx = static_cast<int>(
+      ((atlas::RegularLonLatGrid&)(atlasFunctionSpace_->grid())).nx() );
+    return localIndex(static_cast<int>((gidx-1) % nx),
+                      static_cast<int>((gidx-1) / nx));
+  }
+
 // ----------------------------------------------------------------------------
 
   void Geometry::loadLandMask(const eckit::Configuration &conf) {
@@ -209,7 +263,7 @@ namespace umdsst {
 
     // Create a KD tree for fast lookup
     std::vector<typename KDTree::Value> srcPoints;
-    for (int i = 0; i < srcVal.size(); i++) {
+    for (size_t i = 0; i < srcVal.size(); i++) {
       KDTree::PointType xyz;
       atlas::util::Earth::convertSphericalToCartesian(srcLonLat[i], xyz);
       srcPoints.push_back(KDTree::Value(xyz, srcVal[i]) );
@@ -229,7 +283,7 @@ namespace umdsst {
       auto points = kd.kNearestNeighbours(dstPoint3D, maxSearchPoints);
       double sumDist = 0.0;
       double sumDistVal = 0.0;
-      for ( int n = 0; n < points.size(); n++ ) {
+      for ( size_t n = 0; n < points.size(); n++ ) {
         if ( points[n].distance() < 1.0e-6 ) {
           sumDist = 1.0;
           sumDistVal = points[n].payload();
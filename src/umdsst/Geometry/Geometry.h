@@ -8,6 +8,7 @@
 #ifndef UMDSST_GEOMETRY_GEOMETRY_H_
 #define UMDSST_GEOMETRY_GEOMETRY_H_
 
+#include <map>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -48,6 +49,16 @@ namespace umdsst {
     // accessors
     const eckit::mpi::Comm & getComm() const {return comm_;}
 
+    // number of vertical levels of a variable, 1 (a 2D surface field) unless
+    // given in the "levels" section of the configuration
+    int levels(const std::string &) const;
+
+    // O(1) mapping of a global grid point, given either as (i, j) (0 based,
+    // j=0 is the northern most row) or as a 1 based atlas global index, to
+    // its index on this PE. Returns -1 if the point is owned by another PE.
+    int localIndex(const int i, const int j) const;
+    int localIndex(const atlas::gidx_t) const;
+
     // These are needed for the GeometryIterator Interface
     // TODO(template_impl) GeometryIterator begin() const;
     // TODO(template_impl) GeometryIterator end() const;
@@ -56,6 +67,10 @@ namespace umdsst {
         return atlasFunctionSpace_.get();
     }
 
+    // same partitioning as atlasFunctionSpace(), with a halo of 1 point for
+    // operators that need the neighbors of a point. Created on first use.
+    atlas::functionspace::StructuredColumns* atlasFunctionSpaceHalo() const;
+
     // Ligang: 20210111, adjust for JEDI rep updates.
     atlas::FieldSet* atlasFieldSet() const {
       return atlasFieldSet_.get();
@@ -70,7 +85,10 @@ namespace umdsst {
 
     std::unique_ptr<atlas::functionspace::StructuredColumns>
       atlasFunctionSpace_;
+    mutable std::unique_ptr<atlas::functionspace::StructuredColumns>
+      atlasFunctionSpaceHalo_;
     std::unique_ptr<atlas::FieldSet> atlasFieldSet_;
+    std::map<std::string, int> levels_;
   };
 }  // namespace umdsst
 
@@ -8,47 +8,78 @@
 #ifndef UMDSST_GETVALUES_GEOVALSWRAPPER_H_
 #define UMDSST_GETVALUES_GEOVALSWRAPPER_H_
 
+#include <utility>
 #include <vector>
 
-#include "ufo/GeoVaLs.h"
+#include "umdsst/GetValues/LocationsWrapper.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
 
 #include "oops/util/DateTime.h"
-#include "ufo/Locations.h"
+#include "ufo/GeoVaLs.h"
 
 namespace umdsst {
 
 extern "C" {
-  void geovals_wrapper_fill_f90(const int &,
-                                const ufo::Locations &,
-                                const util::DateTime **,
-                                const util::DateTime **,
-                                      atlas::field::FieldImpl **,
-                                const int & size);
+  void geovals_wrapper_data_f90(const int &, const int & nvar, double **);
 }
 
+  // Copies between the location fields (one per variable, one value per
+  // location) and the GeoVaLs. The values of the GeoVaLs (one level per
+  // variable) are read and written in place, at the addresses given by the
+  // Fortran the first time a GeoVaLs is seen, when it also sets up their
+  // storage. There is no Fortran time mask: only the locations of the slot
+  // are copied, found from the locations sorted by time, and the GeoVaLs
+  // keep the values of the other locations.
   class GeoVaLsWrapper {
    public:
-    explicit GeoVaLsWrapper(const ufo::GeoVaLs & geovals,
-                            const ufo::Locations & locs)
-     : geovals_(&geovals), locs_(locs) {}
-
-    void fill(const util::DateTime & t1,
-              const util::DateTime & t2,
-              const std::vector<atlas::Field> & fields) {
-      const util::DateTime * t1p = &t1;
-      const util::DateTime * t2p = &t2;
-
-      std::vector<atlas::field::FieldImpl*> flds;
-      for (int i = 0; i < fields.size(); i++)
-        flds.push_back((atlas::field::FieldImpl*)(fields[i].get()));
-
-      geovals_wrapper_fill_f90(geovals_->toFortran(), locs_,
-        &t1p, &t2p, flds.data(), flds.size());  // flds.data() <=> ** ;
+    GeoVaLsWrapper() : key_(-1), nlocs_(0) {}
+
+    // the fields of the GeoVaLs variables, in the same order, at the
+    // locations of times in (t1, t2]
+    void fill(ufo::GeoVaLs & geovals, const std::vector<atlas::Field> & fields,
+              const LocationsWrapper & locs, const util::DateTime & t1,
+              const util::DateTime & t2) {
+      const std::vector<double *> & vals = values(geovals);
+      const std::vector<int> & order = locs.timeOrder();
+      const std::pair<size_t, size_t> slot = locs.slot(t1, t2);
+      for (size_t i = 0; i < vals.size(); i++) {
+        const double * x = atlas::array::make_view<double, 2>(
+          fields[i]).data();
+        for (size_t r = slot.first; r < slot.second; r++)
+          vals[i][order[r]] = x[order[r]];
+      }
+    }
+
+    // the adjoint, the values of variable i of the GeoVaLs at the locations
+    // of times in (t1, t2], the field is left unchanged at the others
+    void fillAD(const ufo::GeoVaLs & geovals, const size_t i,
+                atlas::Field & fld, const LocationsWrapper & locs,
+                const util::DateTime & t1, const util::DateTime & t2) {
+      const double * vals = values(geovals)[i];
+      const std::vector<int> & order = locs.timeOrder();
+      const std::pair<size_t, size_t> slot = locs.slot(t1, t2);
+      double * x = atlas::array::make_view<double, 2>(fld).data();
+      for (size_t r = slot.first; r < slot.second; r++)
+        x[order[r]] = vals[order[r]];
     }
 
    private:
-     const ufo::GeoVaLs *geovals_;
-     const ufo::Locations locs_;
+    // the addresses of the values of each variable, of the last GeoVaLs
+    const std::vector<double *> & values(const ufo::GeoVaLs & geovals) {
+      if (geovals.toFortran() != key_ || geovals.nlocs() != nlocs_) {
+        key_ = geovals.toFortran();
+        nlocs_ = geovals.nlocs();
+        vals_.resize(geovals.getVars().size());
+        geovals_wrapper_data_f90(key_, vals_.size(), vals_.data());
+      }
+      return vals_;
+    }
+
+    int key_;
+    size_t nlocs_;
+    std::vector<double *> vals_;
   };
 }  // namespace umdsst
 
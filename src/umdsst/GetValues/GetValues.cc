@@ -5,17 +5,16 @@
  * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
  */
 
+#include <utility>
 #include <vector>
 
 #include "umdsst/Geometry/Geometry.h"
 #include "umdsst/GetValues/GetValues.h"
 #include "umdsst/GetValues/GeoVaLsWrapper.h"
 #include "umdsst/State/State.h"
-#include "umdsst/VariableChange/Model2GeoVaLs.h"
 
 #include "eckit/config/Configuration.h"
 
-#include "oops/generic/InterpolatorUnstructured.h"
 #include "oops/base/Variables.h"
 #include "oops/util/abor1_cpp.h"
 #include "oops/util/Logger.h"
@@ -30,12 +29,8 @@ namespace umdsst {
   GetValues::GetValues(const Geometry & geom,
                        const ufo::Locations & locs,
                        const eckit::Configuration & config)
-    : geom_(new Geometry(geom)), locs_(locs),
-      model2geovals_(new Model2GeoVaLs(geom, config)) {
-    interpolator_.reset( new oops::InterpolatorUnstructured(
-                               eckit::LocalConfiguration(),
-                               *geom_->atlasFunctionSpace(),
-                               locs_.atlasFunctionSpace()));
+    : geom_(new Geometry(geom)), locs_(locs), time_(locs.times(), config) {
+    interpolator_.reset(InterpolatorBase::create(*geom_, locs_, config));
   }
 
 // -----------------------------------------------------------------------------
@@ -49,30 +44,47 @@ namespace umdsst {
                               const util::DateTime & t2,
                               ufo::GeoVaLs & geovals) const {
     oops::Variables vars = geovals.getVars();
-    std::vector<atlas::Field> fields(vars.size());
-
-    // Do variable change if it has not already been done.
-    // TODO(travis): remove this once Yannick is done rearranging things in oops
-    std::unique_ptr<State> varChangeState;
-    const State * state_ptr;
-    if (geovals.getVars() <= state.variables()) {
-      state_ptr = &state;
-    } else {
-      varChangeState.reset(new State(*geom_, geovals.getVars(),
-                                     state.validTime()));
-      model2geovals_->changeVar(state, *varChangeState);
-      state_ptr = varChangeState.get();
+
+    // the location fields are kept between the time slots, each slot only
+    // writes its own locations
+    while (fields_.size() < vars.size()) {
+      fields_.push_back(locs_.atlasFunctionSpace()->createField<double>(
+                          atlas::option::levels(1)));
+      atlas::array::make_view<double, 2>(fields_.back()).assign(0.0);
     }
 
-    // interpolate
+    // interpolate, to the locations of (t1, t2], or of the range of the
+    // state when blending the states in time. The sea area fraction comes
+    // from the land mask, which is static, so it is kept by the interpolator
+    // rather than computed on the grid at each call.
+    std::pair<util::DateTime, util::DateTime> written(t1, t2);
+    if (time_.linear()) {
+      written = time_.begin(state.validTime(), t1, t2);
+      if (!work_)
+        work_ = locs_.atlasFunctionSpace()->createField<double>(
+          atlas::option::levels(1));
+    }
     for (size_t i = 0; i < vars.size(); i++) {
-      fields[i] = locs_.atlasFunctionSpace()->createField<double>(
-                                                 atlas::option::levels(1));
-      interpolator_->apply(state_ptr->atlasFieldSet()->field(vars[i]),
-                           fields[i]);
+      if (state.variables().has(vars[i]) && !time_.linear()) {
+        interpolator_->apply(state.atlasFieldSet()->field(vars[i]),
+                             fields_[i], t1, t2);
+      } else if (state.variables().has(vars[i])) {
+        interpolator_->apply(state.atlasFieldSet()->field(vars[i]), work_,
+                             written.first, written.second);
+        time_.blend(atlas::array::make_view<double, 2>(work_).data(),
+                    atlas::array::make_view<double, 2>(fields_[i]).data(),
+                    state.validTime());
+      } else if (vars[i] == "sea_area_fraction") {
+        interpolator_->seaAreaFraction(fields_[i], written.first,
+                                       written.second);
+      } else {
+        util::abor1_cpp("GetValues::fillGeoVaLs(), variable " + vars[i] +
+                        " not available", __FILE__, __LINE__);
+      }
     }
 
-    GeoVaLsWrapper(geovals, locs_.locs()).fill(t1, t2, fields);
+    geovalsWrapper_.fill(geovals, fields_, locs_, written.first,
+                         written.second);
   }
 
 // ----------------------------------------------------------------------------
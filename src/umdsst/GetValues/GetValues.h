@@ -11,9 +11,12 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <vector>
 
 #include "umdsst/GetValues/LocationsWrapper.h"
+#include "umdsst/GetValues/InterpolatorBase.h"
 #include "umdsst/GetValues/GeoVaLsWrapper.h"
+#include "umdsst/GetValues/TimeInterpolation.h"
 
 #include "oops/util/ObjectCounter.h"
 #include "oops/util/Printable.h"
@@ -24,15 +27,11 @@
 namespace umdsst {
   class Geometry;
   class State;
-  class Model2GeoVaLs;
 }
 
 namespace eckit {
   class Configuration;
 }
-namespace oops {
-  class InterpolatorUnstructured;
-}
 namespace ufo {
   class GeoVaLs;
   class Locations;
@@ -64,10 +63,13 @@ namespace umdsst {
    private:
     void print(std::ostream &) const;
 
-    std::unique_ptr<Model2GeoVaLs> model2geovals_;
-    std::unique_ptr<oops::InterpolatorUnstructured> interpolator_;
+    std::unique_ptr<InterpolatorBase> interpolator_;
     std::shared_ptr<const Geometry> geom_;
     LocationsWrapper locs_;
+    mutable TimeInterpolation time_;
+    mutable std::vector<atlas::Field> fields_;
+    mutable atlas::Field work_;  // a state at the locations, to be blended
+    mutable GeoVaLsWrapper geovalsWrapper_;
   };
 }  // namespace umdsst
 
@@ -0,0 +1,44 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <string>
+
+#include "umdsst/GetValues/InterpolatorBase.h"
+#include "umdsst/GetValues/LocationsWrapper.h"
+#include "umdsst/GetValues/StructuredInterpolator.h"
+#include "umdsst/GetValues/UnstructuredInterpolator.h"
+
+#include "eckit/config/Configuration.h"
+
+#include "oops/util/abor1_cpp.h"
+
+#include "ufo/Locations.h"
+
+namespace umdsst {
+
+// ----------------------------------------------------------------------------
+
+  InterpolatorBase * InterpolatorBase::create(
+    const Geometry & geom, const LocationsWrapper & locs,
+    const eckit::Configuration & conf) {
+    const std::string name = conf.getString("interpolator", "unstructured");
+    if (name == "unstructured") {
+      return new UnstructuredInterpolator(geom, locs.atlasFunctionSpace(),
+                                          locs.locs().times());
+    } else if (name == "structured") {
+      return new StructuredInterpolator(geom, locs.locs().lons(),
+                                        locs.locs().lats(),
+                                        locs.locs().times(), conf);
+    }
+    util::abor1_cpp("InterpolatorBase::create(), unknown interpolator \""
+                    + name + "\"", __FILE__, __LINE__);
+    return nullptr;
+  }
+
+// ----------------------------------------------------------------------------
+
+}  // namespace umdsst
@@ -0,0 +1,65 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_GETVALUES_INTERPOLATORBASE_H_
+#define UMDSST_GETVALUES_INTERPOLATORBASE_H_
+
+#include "oops/util/DateTime.h"
+#include "oops/util/Printable.h"
+
+// forward declarations
+namespace atlas {
+  class Field;
+}
+namespace eckit {
+  class Configuration;
+}
+namespace umdsst {
+  class Geometry;
+  class LocationsWrapper;
+}
+
+// ----------------------------------------------------------------------------
+
+namespace umdsst {
+
+  // Base class of the interpolations from the grid of the Geometry to the
+  // locations of GetValues and LinearGetValues. The location fields have
+  // one value per location for each level of the grid field. The applies
+  // are given the time slot (t1, t2] of the call, the values of the
+  // locations outside of it are not used.
+  class InterpolatorBase : public util::Printable {
+   public:
+    virtual ~InterpolatorBase() {}
+
+    // the interpolator chosen by "interpolator": "unstructured" (the
+    // default, oops::InterpolatorUnstructured) or "structured"
+    static InterpolatorBase * create(const Geometry &, const LocationsWrapper &,
+                                     const eckit::Configuration &);
+
+    // from the grid to the locations, at least those in (t1, t2]
+    virtual void apply(const atlas::Field &, atlas::Field &,
+                       const util::DateTime &,
+                       const util::DateTime &) const = 0;
+    virtual void applyTL(const atlas::Field &, atlas::Field &,
+                         const util::DateTime &,
+                         const util::DateTime &) const = 0;
+
+    // adjoint of applyTL for the locations in (t1, t2], into the grid field
+    virtual void applyAD(const atlas::Field &, atlas::Field &,
+                         const util::DateTime &,
+                         const util::DateTime &) const = 0;
+
+    // the land mask ("gmask" as 0 or 1) interpolated to the locations, at
+    // least those in (t1, t2]
+    virtual void seaAreaFraction(atlas::Field &, const util::DateTime &,
+                                 const util::DateTime &) const = 0;
+  };
+
+}  // namespace umdsst
+
+#endif  // UMDSST_GETVALUES_INTERPOLATORBASE_H_
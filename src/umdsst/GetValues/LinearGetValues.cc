@@ -6,6 +6,7 @@
  */
 
 
+#include <utility>
 #include <vector>
 
 #include "umdsst/GetValues/LinearGetValues.h"
@@ -13,11 +14,9 @@
 #include "umdsst/Geometry/Geometry.h"
 #include "umdsst/Increment/Increment.h"
 #include "umdsst/GetValues/GeoVaLsWrapper.h"
-#include "umdsst/GetValues/GeoVaLsWrapperAD.h"
 
 #include "eckit/config/Configuration.h"
 
-#include "oops/generic/InterpolatorUnstructured.h"
 #include "oops/base/Variables.h"
 #include "oops/util/abor1_cpp.h"
 
@@ -31,11 +30,8 @@ namespace umdsst {
   LinearGetValues::LinearGetValues(const Geometry & geom,
                                    const ufo::Locations & locs,
                                    const eckit::Configuration & config)
-    : geom_( new Geometry(geom)), locs_(locs) {
-    interpolator_.reset( new oops::InterpolatorUnstructured(
-                               eckit::LocalConfiguration(),
-                               *geom_->atlasFunctionSpace(),
-                               locs_.atlasFunctionSpace()) );
+    : geom_( new Geometry(geom)), locs_(locs), time_(locs.times(), config) {
+    interpolator_.reset(InterpolatorBase::create(*geom_, locs_, config));
   }
 
 // ----------------------------------------------------------------------------
@@ -49,18 +45,27 @@ namespace umdsst {
                                       const util::DateTime & t2,
                                       const ufo::GeoVaLs & geovals) const {
     oops::Variables vars = geovals.getVars();
+    const std::pair<util::DateTime, util::DateTime> read =
+      time_.linear() ? time_.range(inc.validTime()) : std::make_pair(t1, t2);
     for (size_t i = 0; i < vars.size(); i++) {
       // expect only sst for now
       if (vars[i] != "sea_surface_temperature")
         util::abor1_cpp("LinearGetValues::fillGeoVaLsAD,unkown state variable");
 
-      atlas::Field fgvl = locs_.atlasFunctionSpace()->createField<double>(
-                                                 atlas::option::levels(1));
-      // copy from geovals to fin so it can be used in apply_ad;
-      GeoVaLsWrapperAD(geovals, locs_.locs()).fill(t1, t2, fgvl);
-
-      interpolator_->apply_ad(fgvl,
-        inc.atlasFieldSet()->field("sea_surface_temperature"));
+      atlas::Field & fgvl = locationFields(adFields_, vars.size())[i];
+      // copy from geovals to fgvl so it can be used in applyAD, only the
+      // locations the applyAD uses
+      adGeoVaLs_.fillAD(geovals, i, fgvl, locs_, read.first, read.second);
+
+      atlas::Field fld = inc.atlasFieldSet()->field("sea_surface_temperature");
+      if (!time_.linear()) {
+        interpolator_->applyAD(fgvl, fld, t1, t2);
+        continue;
+      }
+      time_.weight(atlas::array::make_view<double, 2>(fgvl).data(),
+                   atlas::array::make_view<double, 2>(workField()).data(),
+                   inc.validTime());
+      interpolator_->applyAD(workField(), fld, read.first, read.second);
     }
   }
 
@@ -71,19 +76,27 @@ namespace umdsst {
                                       const util::DateTime & t2,
                                       ufo::GeoVaLs & geovals) const {
     oops::Variables vars = geovals.getVars();
-    std::vector<atlas::Field> fields(vars.size());
+    std::vector<atlas::Field> & fields = locationFields(tlFields_,
+                                                        vars.size());
+    const std::pair<util::DateTime, util::DateTime> written =
+      time_.linear() ? time_.range(inc.validTime()) : std::make_pair(t1, t2);
     for (size_t i = 0; i < vars.size(); i++) {
       // expect only sst for now
       if (vars[i] != "sea_surface_temperature")
         util::abor1_cpp("LinearGetValues::fillGeoVaLsTL,unkown state variable");
 
-      fields[i] = locs_.atlasFunctionSpace()->createField<double>(
-                                         atlas::option::levels(1));
-
-      interpolator_->apply(
-        inc.atlasFieldSet()->field("sea_surface_temperature"), fields[i]);
+      const atlas::Field & fld =
+        inc.atlasFieldSet()->field("sea_surface_temperature");
+      if (!time_.linear()) {
+        interpolator_->applyTL(fld, fields[i], t1, t2);
+        continue;
+      }
+      interpolator_->applyTL(fld, workField(), written.first, written.second);
+      time_.blend(atlas::array::make_view<double, 2>(workField()).data(),
+                  atlas::array::make_view<double, 2>(fields[i]).data(),
+                  inc.validTime());
     }
-    GeoVaLsWrapper(geovals, locs_.locs()).fill(t1, t2, fields);
+    tlGeoVaLs_.fill(geovals, fields, locs_, written.first, written.second);
   }
 
 // ----------------------------------------------------------------------------
@@ -93,19 +106,53 @@ namespace umdsst {
                                       const util::DateTime & t2,
                                       ufo::GeoVaLs & geovals) {
     oops::Variables vars = geovals.getVars();
-    std::vector<atlas::Field> fields(vars.size());
+    std::vector<atlas::Field> & fields = locationFields(trajFields_,
+                                                        vars.size());
+    std::pair<util::DateTime, util::DateTime> written(t1, t2);
+    if (time_.linear()) written = time_.begin(state.validTime(), t1, t2);
     for (size_t i = 0; i < vars.size(); i++) {
       // expect only sst for now
       if (vars[i] != "sea_surface_temperature")
         util::abor1_cpp("LinearGetValues::setTrajectory,unkown state variable");
 
-      fields[i] = locs_.atlasFunctionSpace()->createField<double>(
-                                         atlas::option::levels(1));
+      const atlas::Field & fld =
+        state.atlasFieldSet()->field("sea_surface_temperature");
+      if (!time_.linear()) {
+        interpolator_->apply(fld, fields[i], t1, t2);
+        continue;
+      }
+      interpolator_->apply(fld, workField(), written.first, written.second);
+      time_.blend(atlas::array::make_view<double, 2>(workField()).data(),
+                  atlas::array::make_view<double, 2>(fields[i]).data(),
+                  state.validTime());
+    }
+    trajGeoVaLs_.fill(geovals, fields, locs_, written.first, written.second);
+  }
+
+// ----------------------------------------------------------------------------
 
-      interpolator_->apply(
-        state.atlasFieldSet()->field("sea_surface_temperature"), fields[i]);
+  std::vector<atlas::Field> &
+    LinearGetValues::locationFields(std::vector<atlas::Field> & fields,
+                                    const size_t nvars) const {
+    // the TL and AD run in every inner iteration, so the fields are kept
+    // rather than allocated at each call. Each pass has its own, so that
+    // the values blended in time from the previous state of a pass are
+    // never those of another pass.
+    while (fields.size() < nvars) {
+      fields.push_back(locs_.atlasFunctionSpace()->createField<double>(
+                         atlas::option::levels(1)));
+      atlas::array::make_view<double, 2>(fields.back()).assign(0.0);
     }
-    GeoVaLsWrapper(geovals, locs_.locs()).fill(t1, t2, fields);
+    return fields;
+  }
+
+// ----------------------------------------------------------------------------
+
+  atlas::Field & LinearGetValues::workField() const {
+    if (!work_)
+      work_ = locs_.atlasFunctionSpace()->createField<double>(
+        atlas::option::levels(1));
+    return work_;
   }
 
 // ----------------------------------------------------------------------------
@@ -11,9 +11,12 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <vector>
 
+#include "umdsst/GetValues/GeoVaLsWrapper.h"
+#include "umdsst/GetValues/InterpolatorBase.h"
 #include "umdsst/GetValues/LocationsWrapper.h"
-// #include "umdsst/GetValues/GeoVaLsWrapper.h"
+#include "umdsst/GetValues/TimeInterpolation.h"
 
 #include "oops/util/ObjectCounter.h"
 #include "oops/util/Printable.h"
@@ -24,9 +27,6 @@
 namespace eckit {
   class Configuration;
 }
-namespace oops {
-  class InterpolatorUnstructured;
-}
 namespace ufo {
   class GeoVaLs;
   class Locations;
@@ -71,9 +71,26 @@ namespace umdsst {
    private:
     void print(std::ostream &) const;
 
-    std::unique_ptr<oops::InterpolatorUnstructured> interpolator_;
+    // the location fields of each variable, created once for each of the
+    // trajectory, TL and AD, and one more for a state or increment before
+    // it is blended in time
+    std::vector<atlas::Field> & locationFields(std::vector<atlas::Field> &,
+                                               const size_t) const;
+    atlas::Field & workField() const;
+
+    std::unique_ptr<InterpolatorBase> interpolator_;
     std::shared_ptr<const Geometry> geom_;
     LocationsWrapper locs_;
+    TimeInterpolation time_;
+    mutable std::vector<atlas::Field> trajFields_;
+    mutable std::vector<atlas::Field> tlFields_;
+    mutable std::vector<atlas::Field> adFields_;
+    mutable atlas::Field work_;
+
+    // the copies to and from the GeoVaLs of each pass
+    mutable GeoVaLsWrapper trajGeoVaLs_;
+    mutable GeoVaLsWrapper tlGeoVaLs_;
+    mutable GeoVaLsWrapper adGeoVaLs_;
   };
 }  // namespace umdsst
 
@@ -8,12 +8,17 @@
 #ifndef UMDSST_GETVALUES_LOCATIONSWRAPPER_H_
 #define UMDSST_GETVALUES_LOCATIONSWRAPPER_H_
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "atlas/array.h"
 #include "atlas/functionspace.h"
 
+#include "oops/util/DateTime.h"
+
 #include "ufo/Locations.h"
 
 namespace umdsst {
@@ -25,11 +30,22 @@ namespace umdsst {
                          atlas::array::make_datatype<double>(),
                          atlas::array::make_shape(locs.size(), 2) );
       auto fd = atlas::array::make_view<double, 2>(field);
-      for (int j = 0; j < locs.size(); j++) {
+      for (size_t j = 0; j < locs.size(); j++) {
         fd(j, 0) = locs.lons()[j];
         fd(j, 1) = locs.lats()[j];
       }
       functionSpace_.reset(new atlas::functionspace::PointCloud(field));
+
+      // the locations sorted by time, for the time slots
+      const std::vector<util::DateTime> & times = locs.times();
+      order_.resize(times.size());
+      for (size_t j = 0; j < order_.size(); j++) order_[j] = j;
+      std::stable_sort(order_.begin(), order_.end(),
+                       [&times](const int a, const int b) {
+                         return times[a] < times[b];
+                       });
+      for (const int j : order_)
+        sortedTimes_.push_back(times[j].secondsSinceJan1970());
     }
 
     const atlas::FunctionSpace & atlasFunctionSpace() const {
@@ -38,9 +54,25 @@ namespace umdsst {
 
     const ufo::Locations & locs() const { return locs_; }
 
+    // the locations in order of time, and where those of (t1, t2] are in
+    // that order
+    const std::vector<int> & timeOrder() const { return order_; }
+    std::pair<size_t, size_t> slot(const util::DateTime & t1,
+                                   const util::DateTime & t2) const {
+      const auto first = std::upper_bound(sortedTimes_.begin(),
+                                          sortedTimes_.end(),
+                                          t1.secondsSinceJan1970());
+      const auto last = std::upper_bound(first, sortedTimes_.end(),
+                                         t2.secondsSinceJan1970());
+      return std::make_pair(first - sortedTimes_.begin(),
+                            last - sortedTimes_.begin());
+    }
+
    private:
      const ufo::Locations locs_;
      std::unique_ptr<atlas::functionspace::PointCloud> functionSpace_;
+     std::vector<int> order_;
+     std::vector<int64_t> sortedTimes_;
   };
 }  // namespace umdsst
 
@@ -0,0 +1,762 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "umdsst/Geometry/Geometry.h"
+#include "umdsst/GetValues/StructuredInterpolator.h"
+#include "umdsst/Utils/GridCells.h"
+#include "umdsst/Utils/Hash.h"
+
+#include "eckit/config/Configuration.h"
+#include "eckit/filesystem/PathName.h"
+#include "eckit/mpi/Comm.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
+#include "atlas/functionspace.h"
+#include "atlas/grid.h"
+#include "atlas/option.h"
+
+#include "oops/util/abor1_cpp.h"
+#include "oops/util/Logger.h"
+#include "oops/util/missingValues.h"
+#include "oops/util/Timer.h"
+
+using atlas::array::make_view;
+
+namespace umdsst {
+
+namespace {
+  template <typename T>
+  void writeVector(std::ofstream & out, const std::vector<T> & v) {
+    const uint64_t n = v.size();
+    out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+    out.write(reinterpret_cast<const char *>(v.data()), n*sizeof(T));
+  }
+
+  template <typename T>
+  bool readVector(std::ifstream & in, std::vector<T> & v) {
+    uint64_t n = 0;
+    if (!in.read(reinterpret_cast<char *>(&n), sizeof(n))) return false;
+    v.resize(n);
+    return static_cast<bool>(
+      in.read(reinterpret_cast<char *>(v.data()), n*sizeof(T)));
+  }
+}  // namespace
+
+// ----------------------------------------------------------------------------
+
+  StructuredInterpolator::StructuredInterpolator(
+    const Geometry & geom, const std::vector<double> & locLons,
+    const std::vector<double> & locLats,
+    const std::vector<util::DateTime> & locTimes,
+    const eckit::Configuration & conf)
+    : comm_(geom.getComm()), read_(false) {
+    util::Timer timer("umdsst::StructuredInterpolator",
+                      "StructuredInterpolator");
+    nlocs_ = locLons.size();
+    redistribute_ = conf.getBool("redistribute locations", false);
+    locTimes_.resize(nlocs_);
+    for (size_t n = 0; n < nlocs_; n++)
+      locTimes_[n] = locTimes[n].secondsSinceJan1970();
+
+    // the locations interpolated on this PE
+    std::vector<double> interpLons, interpLats;
+    if (redistribute_) {
+      redistribute(geom, locLons, locLats, interpLons, interpLats);
+    } else {
+      interpLons = locLons;
+      interpLats = locLats;
+      times_ = locTimes_;
+    }
+
+    // the rows of the stencils are the locations sorted by time, so that the
+    // locations of a time slot are a range of rows
+    const size_t ninterp = interpLons.size();
+    order_.resize(ninterp);
+    for (size_t n = 0; n < ninterp; n++) order_[n] = n;
+    std::stable_sort(order_.begin(), order_.end(),
+                     [this](const int a, const int b) {
+                       return times_[a] < times_[b]; });
+    std::vector<double> lons(ninterp), lats(ninterp);
+    rowTimes_.resize(ninterp);
+    for (size_t r = 0; r < ninterp; r++) {
+      lons[r] = interpLons[order_[r]];
+      lats[r] = interpLats[order_[r]];
+      rowTimes_[r] = times_[order_[r]];
+    }
+
+    // the key is the same on all PEs, so they all hit or all miss and the
+    // exchanges of computeStencils stay collective
+    const uint64_t key = stencilKey(geom, lons, lats);
+    const size_t cacheSize = conf.getInt("stencil cache.memory entries", 4);
+    st_ = cached(key, cacheSize, nullptr);
+    if (st_) return;
+
+    // check for a complete cache entry on the root PE only, as for the NICAS
+    // cache of BumpCorrelation
+    std::string cacheDir, fileName;
+    int hit = 0;
+    if (conf.has("stencil cache.directory")) {
+      cacheDir = conf.getString("stencil cache.directory") + "/" +
+                 hashHex(key);
+      fileName = cacheDir + "/stencils_" + std::to_string(comm_.rank()) +
+                 ".bin";
+      if (comm_.rank() == 0) {
+        hit = eckit::PathName(cacheDir + "/stencils.done").exists() ? 1 : 0;
+        if (!hit)
+          eckit::PathName(cacheDir).mkdir();
+      }
+      comm_.broadcast(hit, 0);
+    }
+
+    std::shared_ptr<Stencils> st(new Stencils());
+    if (hit) {
+      // a file that cannot be read on any PE makes all of them recompute
+      hit = readStencils(fileName, geom.atlasFunctionSpace()->size(),
+                         ninterp, *st) ? 1 : 0;
+      comm_.allReduceInPlace(hit, eckit::mpi::Operation::MIN);
+    }
+    if (hit) {
+      st_ = st;
+      read_ = true;
+    } else {
+      st_ = computeStencils(geom, lons, lats);
+      if (!cacheDir.empty()) {
+        writeStencils(fileName, *st_);
+        comm_.barrier();
+        if (comm_.rank() == 0) {
+          std::ofstream marker(cacheDir + "/stencils.done");
+          marker << key << std::endl;
+        }
+      }
+    }
+    cached(key, cacheSize, st_);
+    if (!cacheDir.empty())
+      oops::Log::info() << "StructuredInterpolator: stencil cache "
+                        << (hit ? "hit" : "miss") << ", " << cacheDir
+                        << std::endl;
+  }
+
+// ----------------------------------------------------------------------------
+
+  StructuredInterpolator::~StructuredInterpolator() {}
+
+// ----------------------------------------------------------------------------
+
+  std::shared_ptr<const StructuredInterpolator::Stencils>
+    StructuredInterpolator::cached(const uint64_t key, const size_t size,
+                                   std::shared_ptr<const Stencils> st) {
+    // most recently used first. The keys and sizes are the same on all PEs,
+    // so they all keep and evict the same entries.
+    static std::list<std::pair<uint64_t, std::shared_ptr<const Stencils>>>
+      entries;
+    auto it = std::find_if(entries.begin(), entries.end(),
+      [key](const std::pair<uint64_t, std::shared_ptr<const Stencils>> & e) {
+        return e.first == key; });
+    if (it != entries.end()) {
+      if (!st) st = it->second;
+      entries.erase(it);
+    }
+    if (st) entries.emplace_front(key, st);
+    while (entries.size() > size) entries.pop_back();
+    return st;
+  }
+
+// ----------------------------------------------------------------------------
+
+  void StructuredInterpolator::redistribute(
+    const Geometry & geom, const std::vector<double> & locLons,
+    const std::vector<double> & locLats, std::vector<double> & lons,
+    std::vector<double> & lats) {
+    // each location goes to the owner of the south-west (or north-west)
+    // corner of its cell, which owns the other corners too unless the cell
+    // is on the edge of its domain
+    util::Timer timer("umdsst::StructuredInterpolator", "redistribute");
+    const atlas::functionspace::StructuredColumns & fs =
+      *geom.atlasFunctionSpace();
+    const GridCells cells{atlas::RegularLonLatGrid(fs.grid())};
+    const PointOwners owners(fs, comm_);
+    const size_t npe = comm_.size();
+    sendLocs_.assign(npe, std::vector<int>());
+    std::vector<std::vector<double>> sendBuf(npe), recvBuf(npe);
+    for (size_t n = 0; n < nlocs_; n++) {
+      const Cell c = cells.cell(locLons[n], locLats[n]);
+      const int p = owners.owner(c.i0, c.j0);
+      sendLocs_[p].push_back(n);
+      sendBuf[p].push_back(locLons[n]);
+      sendBuf[p].push_back(locLats[n]);
+      sendBuf[p].push_back(static_cast<double>(locTimes_[n]));
+    }
+    comm_.allToAll(sendBuf, recvBuf);
+
+    recvBegin_.assign(npe+1, 0);
+    for (size_t p = 0; p < npe; p++) {
+      recvBegin_[p+1] = recvBegin_[p] + recvBuf[p].size() / 3;
+      for (size_t k = 0; k < recvBuf[p].size(); k += 3) {
+        lons.push_back(recvBuf[p][k]);
+        lats.push_back(recvBuf[p][k+1]);
+        times_.push_back(static_cast<int64_t>(recvBuf[p][k+2]));
+      }
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  uint64_t StructuredInterpolator::stencilKey(
+    const Geometry & geom, const std::vector<double> & lons,
+    const std::vector<double> & lats) const {
+    // The key covers everything the stencils depend on: the grid and its
+    // decomposition, the land mask and the locations of every PE. The sums
+    // over the PEs make it the same on all of them.
+    const atlas::functionspace::StructuredColumns & fs =
+      *geom.atlasFunctionSpace();
+    auto gidx = make_view<atlas::gidx_t, 1>(fs.global_index());
+
+    uint64_t maskHash = 0;
+    if (geom.atlasFieldSet()->has_field("gmask")) {
+      auto mask = make_view<int, 2>(geom.atlasFieldSet()->field("gmask"));
+      for (int i = 0; i < fs.size(); i++)
+        maskHash += hashMix(gidx(i), static_cast<uint64_t>(mask(i, 0)));
+    }
+    uint64_t locHash = hashBytes(lons.data(), lons.size()*sizeof(double));
+    locHash = hashBytes(lats.data(), lats.size()*sizeof(double), locHash);
+    locHash = hashMix(comm_.rank(), locHash);
+    comm_.allReduceInPlace(maskHash, eckit::mpi::Operation::SUM);
+    comm_.allReduceInPlace(locHash, eckit::mpi::Operation::SUM);
+
+    uint64_t key = hashString("bilinear stencils 3");
+    key = hashString(fs.grid().uid(), key);
+    key = hashString(std::to_string(comm_.size()), key);
+    key = hashMix(key, maskHash);
+    key = hashMix(key, locHash);
+    return key;
+  }
+
+// ----------------------------------------------------------------------------
+
+  bool StructuredInterpolator::readStencils(const std::string & fileName,
+                                            const size_t nOwned,
+                                            const size_t nlocs,
+                                            Stencils & st) const {
+    // the sizes and indices are checked against the grid and the locations,
+    // so that a truncated or stale file is recomputed instead of being used
+    std::ifstream in(fileName, std::ios::binary);
+    std::vector<uint64_t> sizes;
+    if (!readVector(in, sizes) || sizes.size() != 3) return false;
+    st.nOwned = sizes[0];
+    st.nRemote = sizes[1];
+    st.width = sizes[2];
+    if (st.nOwned != nOwned || (st.width != 1 && st.width != 4)) return false;
+    const size_t npe = comm_.size();
+    st.send.resize(npe);
+    bool ok = readVector(in, st.index) && readVector(in, st.weight) &&
+              readVector(in, st.valid) && readVector(in, st.seaFraction) &&
+              readVector(in, st.recv);
+    for (std::vector<int> & send : st.send)
+      ok = ok && readVector(in, send);
+    ok = ok && in.peek() == std::ifstream::traits_type::eof();
+    if (!ok || st.index.size() != st.width*nlocs ||
+        st.weight.size() != st.index.size() || st.valid.size() != nlocs ||
+        st.seaFraction.size() != nlocs || st.recv.size() != npe)
+      return false;
+
+    size_t nRemote = 0;
+    for (const size_t n : st.recv) nRemote += n;
+    if (nRemote != st.nRemote) return false;
+    const int npts = st.nOwned + st.nRemote;
+    for (const int k : st.index)
+      if (k < 0 || k >= npts) return false;
+    for (const std::vector<int> & send : st.send)
+      for (const int k : send)
+        if (k < 0 || k >= static_cast<int>(st.nOwned)) return false;
+    return true;
+  }
+
+// ----------------------------------------------------------------------------
+
+  void StructuredInterpolator::writeStencils(const std::string & fileName,
+                                             const Stencils & st) const {
+    std::ofstream out(fileName, std::ios::binary);
+    writeVector(out, std::vector<uint64_t>{st.nOwned, st.nRemote,
+                                           static_cast<uint64_t>(st.width)});
+    writeVector(out, st.index);
+    writeVector(out, st.weight);
+    writeVector(out, st.valid);
+    writeVector(out, st.seaFraction);
+    writeVector(out, st.recv);
+    for (const std::vector<int> & send : st.send)
+      writeVector(out, send);
+    if (!out)
+      oops::Log::warning() << "StructuredInterpolator: could not write "
+                           << fileName << std::endl;
+  }
+
+// ----------------------------------------------------------------------------
+
+  std::shared_ptr<const StructuredInterpolator::Stencils>
+    StructuredInterpolator::computeStencils(
+    const Geometry & geom, const std::vector<double> & lons,
+    const std::vector<double> & lats) const {
+    util::Timer timer("umdsst::StructuredInterpolator", "computeStencils");
+    std::shared_ptr<Stencils> st(new Stencils());
+    const atlas::functionspace::StructuredColumns & fs =
+      *geom.atlasFunctionSpace();
+    const atlas::RegularLonLatGrid grid(fs.grid());
+    const int nx = grid.nx();
+    const int npe = comm_.size();
+    const size_t nlocs = lons.size();
+    st->nOwned = fs.size();
+    const GridCells cells(grid);
+    const PointOwners owners(fs, comm_);
+
+    // Locations on a grid point (observations on the model grid, or on a
+    // grid nested in it) only need that point. When all the locations of
+    // the PE are on grid points the stencils have one point and no weights
+    // to speak of, and the applies are a gather and a scatter.
+    const double eps = 1.0e-6;
+    std::vector<Cell> cell(nlocs);
+    std::vector<char> onGrid(nlocs);
+    st->width = 1;
+    for (size_t n = 0; n < nlocs; n++) {
+      cell[n] = cells.cell(lons[n], lats[n]);
+      onGrid[n] = (cell[n].wx < eps || cell[n].wx > 1.0-eps) &&
+                  (cell[n].wy < eps || cell[n].wy > 1.0-eps);
+      if (!onGrid[n]) st->width = 4;
+    }
+    const int width = st->width;
+
+    // the stencils. The points owned by other PEs are numbered by PE first,
+    // and get their position in the buffer once all of them are known.
+    std::vector<std::vector<int>> request(npe);
+    std::unordered_map<int, int> slot;
+    std::vector<int> slotPe, slotPos;
+    auto pointIndex = [&](const int i, const int j) {
+      const int local = geom.localIndex(i, j);
+      if (local >= 0) return local;
+      const int gid = j*nx + i;
+      auto it = slot.find(gid);
+      if (it == slot.end()) {
+        const int p = owners.owner(i, j);
+        it = slot.insert(std::make_pair(gid, slotPe.size())).first;
+        slotPe.push_back(p);
+        slotPos.push_back(request[p].size());
+        request[p].push_back(gid);
+      }
+      return -1 - it->second;
+    };
+    st->index.resize(width*nlocs);
+    st->weight.resize(width*nlocs);
+    for (size_t n = 0; n < nlocs; n++) {
+      const Cell & c = cell[n];
+      int * idx = &st->index[width*n];
+      double * w = &st->weight[width*n];
+      if (onGrid[n]) {
+        // the other points of a 4 point stencil have no weight, and are the
+        // same point so that they are not requested from other PEs
+        const int k = pointIndex(c.i(), c.j());
+        for (int e = 0; e < width; e++) {
+          idx[e] = k;
+          w[e] = e == 0 ? 1.0 : 0.0;
+        }
+        continue;
+      }
+      const int pi[4] = {c.i0, c.i1, c.i0, c.i1};
+      const int pj[4] = {c.j0, c.j0, c.j1, c.j1};
+      const double pw[4] = {(1.0-c.wx)*(1.0-c.wy), c.wx*(1.0-c.wy),
+                            (1.0-c.wx)*c.wy, c.wx*c.wy};
+      for (int e = 0; e < 4; e++) {
+        idx[e] = pointIndex(pi[e], pj[e]);
+        w[e] = pw[e];
+      }
+    }
+
+    std::vector<size_t> offset(npe+1, 0);
+    for (int p = 0; p < npe; p++)
+      offset[p+1] = offset[p] + request[p].size();
+    st->nRemote = offset[npe];
+    for (int & idx : st->index)
+      if (idx < 0)
+        idx = st->nOwned + offset[slotPe[-1-idx]] + slotPos[-1-idx];
+
+    // the exchange of the remote points
+    std::vector<std::vector<int>> received(npe);
+    comm_.allToAll(request, received);
+    st->send.assign(npe, std::vector<int>());
+    st->recv.resize(npe);
+    for (int p = 0; p < npe; p++) {
+      st->recv[p] = request[p].size();
+      for (const int gid : received[p])
+        st->send[p].push_back(geom.localIndex(gid % nx, gid / nx));
+    }
+
+    // land points are left out, the other weights renormalized. The sum of
+    // the weights of the ocean points is the bilinear interpolation of the
+    // land mask, kept as the sea area fraction.
+    st->valid.assign(nlocs, 1);
+    st->seaFraction.assign(nlocs, 1.0);
+    if (geom.atlasFieldSet()->has_field("gmask")) {
+      const atlas::Field gmask = geom.atlasFieldSet()->field("gmask");
+      atlas::Field ocean = fs.createField<double>(atlas::option::levels(1));
+      auto gmask_view = make_view<int, 2>(gmask);
+      auto ocean_view = make_view<double, 2>(ocean);
+      for (size_t k = 0; k < st->nOwned; k++)
+        ocean_view(k, 0) = gmask_view(k, 0) == 0 ? 0.0 : 1.0;
+      std::vector<double> mask;
+      gatherStencilPoints(*st, ocean, mask);
+      for (size_t n = 0; n < nlocs; n++) {
+        double * w = &st->weight[width*n];
+        double sum = 0.0;
+        for (int e = 0; e < width; e++) {
+          w[e] *= mask[st->index[width*n + e]];
+          sum += w[e];
+        }
+        st->seaFraction[n] = sum;
+        if (sum > 0.0) {
+          for (int e = 0; e < width; e++) w[e] /= sum;
+        } else {
+          st->valid[n] = 0;
+        }
+      }
+    }
+    return st;
+  }
+
+// ----------------------------------------------------------------------------
+
+  std::pair<int, int> StructuredInterpolator::rows(const int64_t t1,
+                                                   const int64_t t2) const {
+    // the locations in (t1, t2], as for the time mask of the GeoVaLs
+    const int r0 = std::upper_bound(rowTimes_.begin(), rowTimes_.end(), t1) -
+                   rowTimes_.begin();
+    const int r1 = std::upper_bound(rowTimes_.begin(), rowTimes_.end(), t2) -
+                   rowTimes_.begin();
+    return std::make_pair(r0, std::max(r0, r1));
+  }
+
+// ----------------------------------------------------------------------------
+
+  const StructuredInterpolator::Transpose &
+    StructuredInterpolator::transpose(const std::pair<int, int> & range)
+    const {
+    auto it = transposes_.find(range);
+    if (it != transposes_.end()) return it->second;
+
+    // counting sort of the nonzero weights of the rows by stencil point,
+    // land points and locations without ocean are left out
+    const Stencils & st = *st_;
+    Transpose & tr = transposes_[range];
+    const size_t width = st.width;
+    const size_t e0 = width*static_cast<size_t>(range.first);
+    const size_t e1 = width*static_cast<size_t>(range.second);
+    std::vector<int> count(st.nOwned + st.nRemote, 0);
+    for (size_t e = e0; e < e1; e++)
+      if (st.weight[e] != 0.0 && st.valid[e / width]) count[st.index[e]]++;
+    std::vector<size_t> next(count.size());
+    tr.begin.push_back(0);
+    for (size_t k = 0; k < count.size(); k++) {
+      if (count[k] == 0) continue;
+      next[k] = tr.begin.back();
+      tr.points.push_back(k);
+      tr.begin.push_back(tr.begin.back() + count[k]);
+    }
+    tr.rows.resize(tr.begin.back());
+    tr.weight.resize(tr.begin.back());
+    for (size_t e = e0; e < e1; e++) {
+      if (st.weight[e] == 0.0 || !st.valid[e / width]) continue;
+      const size_t t = next[st.index[e]]++;
+      tr.rows[t] = e / width;
+      tr.weight[t] = st.weight[e];
+    }
+    return tr;
+  }
+
+// ----------------------------------------------------------------------------
+
+  void StructuredInterpolator::gatherStencilPoints(
+    const Stencils & st, const atlas::Field & fld,
+    std::vector<double> & buf) const {
+    const int nlev = fld.levels();
+    const double * x = make_view<double, 2>(fld).data();
+    buf.resize((st.nOwned + st.nRemote)*nlev);
+    std::copy_n(x, st.nOwned*nlev, buf.begin());
+
+    const size_t npe = comm_.size();
+    sendBuf_.resize(npe);
+    recvBuf_.resize(npe);
+    for (size_t p = 0; p < npe; p++) {
+      sendBuf_[p].resize(st.send[p].size()*nlev);
+      for (size_t n = 0; n < st.send[p].size(); n++)
+        std::copy_n(x + static_cast<size_t>(st.send[p][n])*nlev, nlev,
+                    &sendBuf_[p][n*nlev]);
+    }
+    comm_.allToAll(sendBuf_, recvBuf_);
+    double * remote = buf.data() + st.nOwned*nlev;
+    for (size_t p = 0; p < npe; p++)
+      remote = std::copy_n(recvBuf_[p].begin(), st.recv[p]*nlev, remote);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void StructuredInterpolator::interpolateRows(
+    const atlas::Field & src, double * y, const std::pair<int, int> & range,
+    const bool linear) const {
+    const int nlev = src.levels();
+    gatherStencilPoints(*st_, src, buf_);
+    const double * b = buf_.data();
+    const int * idx = st_->index.data();
+    const double * w = st_->weight.data();
+    const int * loc = order_.data();
+    if (st_->width == 1) {
+      // a gather, the weights are 1 (or 0 for land, where the location is
+      // not valid)
+#pragma omp parallel for
+      for (int r = range.first; r < range.second; r++)
+        std::copy_n(b + static_cast<size_t>(idx[r])*nlev, nlev,
+                    y + static_cast<size_t>(loc[r])*nlev);
+    } else if (nlev == 1) {
+#pragma omp parallel for simd
+      for (int r = range.first; r < range.second; r++)
+        y[loc[r]] = w[4*r]*b[idx[4*r]] + w[4*r+1]*b[idx[4*r+1]] +
+                    w[4*r+2]*b[idx[4*r+2]] + w[4*r+3]*b[idx[4*r+3]];
+    } else {
+#pragma omp parallel for
+      for (int r = range.first; r < range.second; r++) {
+        const double * b0 = b + static_cast<size_t>(idx[4*r])*nlev;
+        const double * b1 = b + static_cast<size_t>(idx[4*r+1])*nlev;
+        const double * b2 = b + static_cast<size_t>(idx[4*r+2])*nlev;
+        const double * b3 = b + static_cast<size_t>(idx[4*r+3])*nlev;
+        double * yn = y + static_cast<size_t>(loc[r])*nlev;
+#pragma omp simd
+        for (int l = 0; l < nlev; l++)
+          yn[l] = w[4*r]*b0[l] + w[4*r+1]*b1[l] + w[4*r+2]*b2[l] +
+                  w[4*r+3]*b3[l];
+      }
+    }
+
+    // no ocean around the location
+    const double missing = util::missingValue(missing);
+    for (int r = range.first; r < range.second; r++)
+      if (!st_->valid[r])
+        std::fill_n(y + static_cast<size_t>(loc[r])*nlev, nlev,
+                    linear ? 0.0 : missing);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void StructuredInterpolator::adjointRows(
+    const double * y, atlas::Field & dst,
+    const std::pair<int, int> & range) const {
+    // the transpose of the rows of the time slot, one stencil point per row
+    // so that the threads write to separate points
+    const Stencils & st = *st_;
+    const int nlev = dst.levels();
+    const Transpose & tr = transpose(range);
+    const int * loc = order_.data();
+    const int npts = tr.points.size();
+    buf_.assign((st.nOwned + st.nRemote)*nlev, 0.0);
+    double * b = buf_.data();
+#pragma omp parallel for
+    for (int q = 0; q < npts; q++) {
+      double * bk = b + static_cast<size_t>(tr.points[q])*nlev;
+      for (size_t t = tr.begin[q]; t < tr.begin[q+1]; t++) {
+        const double w = tr.weight[t];
+        const double * yn = y + static_cast<size_t>(loc[tr.rows[t]])*nlev;
+        for (int l = 0; l < nlev; l++) bk[l] += w * yn[l];
+      }
+    }
+
+    // adjoint of gatherStencilPoints, the remote points go back to their
+    // owners
+    double * x = make_view<double, 2>(dst).data();
+    const int nOwned = st.nOwned*nlev;
+#pragma omp parallel for
+    for (int k = 0; k < nOwned; k++) x[k] += b[k];
+    const size_t npe = comm_.size();
+    sendBuf_.resize(npe);
+    recvBuf_.resize(npe);
+    const double * remote = b + nOwned;
+    for (size_t p = 0; p < npe; p++) {
+      sendBuf_[p].assign(remote, remote + st.recv[p]*nlev);
+      remote += st.recv[p]*nlev;
+    }
+    comm_.allToAll(sendBuf_, recvBuf_);
+    for (size_t p = 0; p < npe; p++)
+      for (size_t n = 0; n < st.send[p].size(); n++)
+        for (int l = 0; l < nlev; l++)
+          x[static_cast<size_t>(st.send[p][n])*nlev + l] +=
+            recvBuf_[p][n*nlev + l];
+  }
+
+// ----------------------------------------------------------------------------
+
+  void StructuredInterpolator::returnValues(const double * y, const int nlev,
+                                            const int64_t t1,
+                                            const int64_t t2,
+                                            atlas::Field & dst) const {
+    // the locations of the slot, in the order they were received from each
+    // PE. The PE of the locations goes through them in the same order.
+    const size_t npe = comm_.size();
+    sendBuf_.resize(npe);
+    recvBuf_.resize(npe);
+    for (size_t p = 0; p < npe; p++) {
+      sendBuf_[p].clear();
+      for (size_t n = recvBegin_[p]; n < recvBegin_[p+1]; n++)
+        if (times_[n] > t1 && times_[n] <= t2)
+          sendBuf_[p].insert(sendBuf_[p].end(), y + n*nlev, y + (n+1)*nlev);
+    }
+    comm_.allToAll(sendBuf_, recvBuf_);
+    double * x = make_view<double, 2>(dst).data();
+    for (size_t p = 0; p < npe; p++) {
+      const double * v = recvBuf_[p].data();
+      for (const int m : sendLocs_[p])
+        if (locTimes_[m] > t1 && locTimes_[m] <= t2) {
+          std::copy_n(v, nlev, x + static_cast<size_t>(m)*nlev);
+          v += nlev;
+        }
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void StructuredInterpolator::sendValues(const atlas::Field & src,
+                                          const int64_t t1, const int64_t t2,
+                                          double * y) const {
+    // adjoint of returnValues, the values outside the slot are not set
+    const int nlev = src.levels();
+    const size_t npe = comm_.size();
+    const double * x = make_view<double, 2>(src).data();
+    sendBuf_.resize(npe);
+    recvBuf_.resize(npe);
+    for (size_t p = 0; p < npe; p++) {
+      sendBuf_[p].clear();
+      for (const int m : sendLocs_[p])
+        if (locTimes_[m] > t1 && locTimes_[m] <= t2)
+          sendBuf_[p].insert(sendBuf_[p].end(), x + m*nlev, x + (m+1)*nlev);
+    }
+    comm_.allToAll(sendBuf_, recvBuf_);
+    for (size_t p = 0; p < npe; p++) {
+      const double * v = recvBuf_[p].data();
+      for (size_t n = recvBegin_[p]; n < recvBegin_[p+1]; n++)
+        if (times_[n] > t1 && times_[n] <= t2) {
+          std::copy_n(v, nlev, y + n*nlev);
+          v += nlev;
+        }
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  void StructuredInterpolator::interpolate(const atlas::Field & src,
+                                           atlas::Field & dst,
+                                           const util::DateTime & t1,
+                                           const util::DateTime & t2,
+                                           const bool linear) const {
+    util::Timer timer("umdsst::StructuredInterpolator", "interpolate");
+    const int nlev = src.levels();
+    if (dst.shape(0) != static_cast<int>(nlocs_) || dst.levels() != nlev)
+      util::abor1_cpp("StructuredInterpolator::interpolate(), wrong shape of "
+                      "the destination field", __FILE__, __LINE__);
+
+    // only the rows of the time slot, the other locations are left as they
+    // are
+    const int64_t s1 = t1.secondsSinceJan1970();
+    const int64_t s2 = t2.secondsSinceJan1970();
+    const std::pair<int, int> range = rows(s1, s2);
+    if (!redistribute_) {
+      interpolateRows(src, make_view<double, 2>(dst).data(), range, linear);
+      return;
+    }
+    locBuf_.resize(times_.size()*nlev);
+    interpolateRows(src, locBuf_.data(), range, linear);
+    returnValues(locBuf_.data(), nlev, s1, s2, dst);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void StructuredInterpolator::apply(const atlas::Field & src,
+                                     atlas::Field & dst,
+                                     const util::DateTime & t1,
+                                     const util::DateTime & t2) const {
+    interpolate(src, dst, t1, t2, false);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void StructuredInterpolator::applyTL(const atlas::Field & src,
+                                       atlas::Field & dst,
+                                       const util::DateTime & t1,
+                                       const util::DateTime & t2) const {
+    interpolate(src, dst, t1, t2, true);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void StructuredInterpolator::applyAD(const atlas::Field & src,
+                                       atlas::Field & dst,
+                                       const util::DateTime & t1,
+                                       const util::DateTime & t2) const {
+    util::Timer timer("umdsst::StructuredInterpolator", "applyAD");
+    const int nlev = dst.levels();
+    if (src.shape(0) != static_cast<int>(nlocs_) || src.levels() != nlev)
+      util::abor1_cpp("StructuredInterpolator::applyAD(), wrong shape of "
+                      "the location field", __FILE__, __LINE__);
+    const int64_t s1 = t1.secondsSinceJan1970();
+    const int64_t s2 = t2.secondsSinceJan1970();
+    const std::pair<int, int> range = rows(s1, s2);
+    if (!redistribute_) {
+      adjointRows(make_view<double, 2>(src).data(), dst, range);
+      return;
+    }
+    locBuf_.resize(times_.size()*nlev);
+    sendValues(src, s1, s2, locBuf_.data());
+    adjointRows(locBuf_.data(), dst, range);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void StructuredInterpolator::seaAreaFraction(
+    atlas::Field & dst, const util::DateTime & t1,
+    const util::DateTime & t2) const {
+    // the land mask is static, so this is a copy of the fractions computed
+    // with the stencils, at the locations of the slot only
+    const int64_t s1 = t1.secondsSinceJan1970();
+    const int64_t s2 = t2.secondsSinceJan1970();
+    const std::pair<int, int> range = rows(s1, s2);
+    double * y = make_view<double, 2>(dst).data();
+    if (redistribute_) {
+      locBuf_.resize(times_.size());
+      y = locBuf_.data();
+    }
+    for (int r = range.first; r < range.second; r++)
+      y[order_[r]] = st_->seaFraction[r];
+    if (redistribute_)
+      returnValues(locBuf_.data(), 1, s1, s2, dst);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void StructuredInterpolator::print(std::ostream & os) const {
+    os << "StructuredInterpolator: " << nlocs_ << " locations, "
+       << st_->nRemote << " grid points from other PEs";
+    if (redistribute_)
+      os << ", " << times_.size() << " locations interpolated on this PE";
+  }
+
+// ----------------------------------------------------------------------------
+
+}  // namespace umdsst
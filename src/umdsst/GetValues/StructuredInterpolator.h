@@ -0,0 +1,215 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_GETVALUES_STRUCTUREDINTERPOLATOR_H_
+#define UMDSST_GETVALUES_STRUCTUREDINTERPOLATOR_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "umdsst/GetValues/InterpolatorBase.h"
+
+#include "oops/util/DateTime.h"
+
+// forward declarations
+namespace atlas {
+  class Field;
+}
+namespace eckit {
+  class Configuration;
+  namespace mpi {
+    class Comm;
+  }
+}
+namespace umdsst {
+  class Geometry;
+}
+
+// ----------------------------------------------------------------------------
+
+namespace umdsst {
+
+  // Bilinear interpolation from the regular lon-lat grid of the Geometry to
+  // a list of locations ("interpolator: structured").
+  //
+  // The cell around a location is found arithmetically from the grid
+  // spacing, so the setup is O(1) per location, with no tree search. The
+  // columns are cyclic across the dateline. Beyond the first and last rows
+  // (near the poles) the values of the nearest row are used. Land points of
+  // the "gmask" are left out of the stencils and the weights of the other
+  // points are renormalized. A location with no ocean point around it has
+  // a missing value (0 for the linear interpolation). Locations on grid
+  // points (e.g. gridded L3 products on the model grid or a grid nested in
+  // it) use that point only, and when all of them are, the applies are a
+  // gather and its adjoint with no weights.
+  //
+  // The locations are sorted by time, so that the applies of a time slot
+  // (t1, t2] only go through the locations of the slot.
+  //
+  // The grid points of the stencils owned by other PEs are requested once
+  // at setup, and only their values are exchanged at each apply. With
+  // "redistribute locations", each location is instead interpolated on the
+  // PE that owns its grid cell, so that only the points along the edges of
+  // the PE domains are exchanged, and the values go back to the PE of the
+  // location in one all to all of the values of the slot.
+  //
+  // The stencils are kept in memory, keyed by the grid, its decomposition,
+  // the land mask and the locations, so that the GetValues and
+  // LinearGetValues of the same observations, and later cycles with the
+  // same locations (e.g. L3 products on a fixed grid), share them. Only the
+  // "stencil cache.memory entries" (default 4) most recently used are kept
+  // beyond the interpolators using them. With a "stencil cache.directory"
+  // they are also written to disk, one file per PE, and read back by later
+  // runs once checked against the grid and the locations.
+  class StructuredInterpolator : public InterpolatorBase {
+   public:
+    StructuredInterpolator(const Geometry &, const std::vector<double> & lons,
+                           const std::vector<double> & lats,
+                           const std::vector<util::DateTime> & times,
+                           const eckit::Configuration &);
+    ~StructuredInterpolator();
+
+    // only the locations in (t1, t2] are written, the others are left
+    // unchanged
+    void apply(const atlas::Field &, atlas::Field &, const util::DateTime &,
+               const util::DateTime &) const override;
+    void applyTL(const atlas::Field &, atlas::Field &, const util::DateTime &,
+                 const util::DateTime &) const override;
+
+    // added to the grid field
+    void applyAD(const atlas::Field &, atlas::Field &, const util::DateTime &,
+                 const util::DateTime &) const override;
+
+    // without the grid, from the stencils
+    void seaAreaFraction(atlas::Field &, const util::DateTime &,
+                         const util::DateTime &) const override;
+
+    size_t locations() const { return nlocs_; }
+
+    // how the stencils were set up: shared with another interpolator through
+    // the memory cache, read back from the disk cache, and their width on
+    // this PE
+    bool sharesStencils(const StructuredInterpolator & other) const {
+      return st_ == other.st_;
+    }
+    bool stencilsRead() const { return read_; }
+    int stencilWidth() const { return st_->width; }
+
+   private:
+    struct Stencils {
+      size_t nOwned;
+      size_t nRemote;
+
+      // the matrix, "width" points and weights per location (CSR with rows
+      // of a fixed length), the indices are in the buffer of
+      // gatherStencilPoints. The width is 1 when all the locations are on
+      // grid points, 4 otherwise.
+      int width;
+      std::vector<int> index;
+      std::vector<double> weight;
+      std::vector<char> valid;
+      std::vector<double> seaFraction;
+
+      // send[p]: local indices of the points sent to PE p, recv[p]: number
+      // of points received from PE p
+      std::vector<std::vector<int>> send;
+      std::vector<size_t> recv;
+    };
+
+    // the transpose of a range of rows in CSR form, only for the stencil
+    // points that the rows use: the nonzero weights of points[q] and their
+    // rows are from begin[q] to begin[q+1]
+    struct Transpose {
+      std::vector<int> points;
+      std::vector<size_t> begin;
+      std::vector<int> rows;
+      std::vector<double> weight;
+    };
+
+    void print(std::ostream &) const override;
+
+    // sends the locations to the PEs that own their grid cells, and returns
+    // the locations received, to be interpolated on this PE
+    void redistribute(const Geometry &, const std::vector<double> &,
+                      const std::vector<double> &, std::vector<double> &,
+                      std::vector<double> &);
+
+    std::shared_ptr<const Stencils> computeStencils(
+      const Geometry &, const std::vector<double> &,
+      const std::vector<double> &) const;
+    uint64_t stencilKey(const Geometry &, const std::vector<double> &,
+                        const std::vector<double> &) const;
+    bool readStencils(const std::string &, const size_t, const size_t,
+                      Stencils &) const;
+    void writeStencils(const std::string &, const Stencils &) const;
+
+    // the grid values needed by the stencils, those owned by this PE followed
+    // by those received from other PEs
+    void gatherStencilPoints(const Stencils &, const atlas::Field &,
+                             std::vector<double> &) const;
+
+    // the stencils of a range of rows and their adjoint, the location values
+    // are those of the locations interpolated on this PE
+    void interpolateRows(const atlas::Field &, double *,
+                         const std::pair<int, int> &, const bool) const;
+    void adjointRows(const double *, atlas::Field &,
+                     const std::pair<int, int> &) const;
+    void interpolate(const atlas::Field &, atlas::Field &,
+                     const util::DateTime &, const util::DateTime &,
+                     const bool) const;
+
+    // with "redistribute locations", the values of the locations of the
+    // slot from the PEs that interpolate them to the PEs of the locations,
+    // and the reverse
+    void returnValues(const double *, const int, const int64_t,
+                      const int64_t, atlas::Field &) const;
+    void sendValues(const atlas::Field &, const int64_t, const int64_t,
+                    double *) const;
+
+    // the rows of a time slot, and their transpose, built on first use
+    std::pair<int, int> rows(const int64_t, const int64_t) const;
+    const Transpose & transpose(const std::pair<int, int> &) const;
+
+    // the stencils kept in memory, the last "memory entries" used (a null
+    // pointer when not kept). Storing stencils moves them to the front.
+    static std::shared_ptr<const Stencils> cached(
+      const uint64_t, const size_t, std::shared_ptr<const Stencils>);
+
+    const eckit::mpi::Comm & comm_;
+    size_t nlocs_;
+    bool redistribute_;
+    bool read_;
+    std::shared_ptr<const Stencils> st_;
+
+    // the locations interpolated on this PE: their times (in seconds), and
+    // the location and time of each row of the stencils
+    std::vector<int64_t> times_;
+    std::vector<int> order_;
+    std::vector<int64_t> rowTimes_;
+    mutable std::map<std::pair<int, int>, Transpose> transposes_;
+
+    // with "redistribute locations": the times of the locations of this
+    // PE, those sent to each PE, and where the locations received from
+    // each PE start
+    std::vector<int64_t> locTimes_;
+    std::vector<std::vector<int>> sendLocs_;
+    std::vector<size_t> recvBegin_;
+
+    // work space of the applies, kept between calls
+    mutable std::vector<double> buf_;
+    mutable std::vector<double> locBuf_;
+    mutable std::vector<std::vector<double>> sendBuf_, recvBuf_;
+  };
+
+}  // namespace umdsst
+
+#endif  // UMDSST_GETVALUES_STRUCTUREDINTERPOLATOR_H_
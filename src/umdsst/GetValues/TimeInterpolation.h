@@ -0,0 +1,168 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_GETVALUES_TIMEINTERPOLATION_H_
+#define UMDSST_GETVALUES_TIMEINTERPOLATION_H_
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "eckit/config/Configuration.h"
+
+#include "oops/util/abor1_cpp.h"
+#include "oops/util/DateTime.h"
+#include "oops/util/missingValues.h"
+
+namespace umdsst {
+
+  // The "time interpolation" of the GetValues between the states of the
+  // window (first guess at appropriate time):
+  //  - "nearest" (default): the locations of a time slot (t1, t2] get the
+  //    values of the state of the slot.
+  //  - "linear": the values of the states before and after a location are
+  //    blended linearly in time.
+  //
+  // The states of a forward pass (GetValues, or the trajectory of
+  // LinearGetValues) come in order of time, and a state at or before the
+  // previous one starts a new pass. Each state is "begin"-ed before it is
+  // blended, which sets the weights of the locations it contributes to:
+  //  - after t, up to the next state: the value of the state, as the next
+  //    state is not known yet. The next state is assumed one slot later
+  //    (at 2 t2 - t), a later one only blends the locations this reached.
+  //  - between the previous state of the pass and t: the blend of the two
+  //    states, for the locations the previous state gave its value to.
+  //    The others (no previous state, as for a single state in 3D-Var, or
+  //    states further apart than their slots) get the nearest state.
+  // The TL and AD reuse the weights and ranges of the last forward pass.
+  class TimeInterpolation {
+   public:
+    TimeInterpolation(const std::vector<util::DateTime> & times,
+                      const eckit::Configuration & conf)
+      : pass_(0), inPass_(false) {
+      const std::string method = conf.getString("time interpolation",
+                                                "nearest");
+      if (method != "nearest" && method != "linear")
+        util::abor1_cpp("TimeInterpolation, unknown \"time interpolation\" "
+                        + method, __FILE__, __LINE__);
+      linear_ = method == "linear";
+      for (const util::DateTime & t : times)
+        times_.push_back(t.secondsSinceJan1970());
+      if (linear_) {
+        from_.assign(times_.size(), none());
+        to_.assign(times_.size(), none());
+        alpha_.assign(times_.size(), 0.0);
+        fromPass_.assign(times_.size(), -1);
+      }
+    }
+
+    bool linear() const { return linear_; }
+
+    // sets the weights of the state valid at t of a forward pass, given its
+    // slot (t1, t2], and returns the locations it contributes to
+    std::pair<util::DateTime, util::DateTime> begin(
+      const util::DateTime & t, const util::DateTime & t1,
+      const util::DateTime & t2) {
+      const int64_t tc = t.secondsSinceJan1970();
+      const bool newPass = !inPass_ || tc <= last_.secondsSinceJan1970();
+      if (newPass) pass_++;
+      const util::DateTime lo = newPass ? t1 : last_;
+      const util::DateTime hi = t2 + (t2 - t);
+      const int64_t tp = newPass ? none() : last_.secondsSinceJan1970();
+      const int64_t tl = lo.secondsSinceJan1970();
+      const int64_t th = hi.secondsSinceJan1970();
+      for (size_t n = 0; n < times_.size(); n++) {
+        const int64_t tau = times_[n];
+        if (tau <= tl || tau > th) continue;
+        if (tau <= tc && fromPass_[n] == pass_ && from_[n] == tp) {
+          to_[n] = tc;
+          alpha_[n] = static_cast<double>(tau - tp) / (tc - tp);
+        } else {
+          from_[n] = tc;
+          to_[n] = none();
+          alpha_[n] = 0.0;
+          fromPass_[n] = pass_;
+        }
+      }
+      inPass_ = true;
+      last_ = t;
+      ranges_[tc] = std::make_pair(lo, hi);
+      return ranges_[tc];
+    }
+
+    // the locations the state valid at t contributed to in the last
+    // forward pass
+    const std::pair<util::DateTime, util::DateTime> & range(
+      const util::DateTime & t) const {
+      auto it = ranges_.find(t.secondsSinceJan1970());
+      if (it == ranges_.end())
+        util::abor1_cpp("TimeInterpolation::range(), no trajectory at "
+                        + t.toString(), __FILE__, __LINE__);
+      return it->second;
+    }
+
+    // y = x where t is the state the location starts from, y += a (x - y)
+    // where t is the state it is blended towards, with x the state
+    // interpolated to its range. The missing values (no ocean around the
+    // location) are the same for all the states, and stay missing.
+    void blend(const double * x, double * y, const util::DateTime & t) const {
+      const double missing = util::missingValue(missing);
+      const int64_t tc = t.secondsSinceJan1970();
+      const std::pair<util::DateTime, util::DateTime> & r = range(t);
+      const int64_t tl = r.first.secondsSinceJan1970();
+      const int64_t th = r.second.secondsSinceJan1970();
+      for (size_t n = 0; n < times_.size(); n++) {
+        if (times_[n] <= tl || times_[n] > th) continue;
+        if (x[n] == missing)
+          y[n] = missing;
+        else if (from_[n] == tc)
+          y[n] = x[n];
+        else if (to_[n] == tc && y[n] != missing)
+          y[n] += alpha_[n] * (x[n] - y[n]);
+      }
+    }
+
+    // adjoint of blend: the weights of the state valid at t, applied to the
+    // values at the locations of its range
+    void weight(const double * y, double * x, const util::DateTime & t) const {
+      const int64_t tc = t.secondsSinceJan1970();
+      const std::pair<util::DateTime, util::DateTime> & r = range(t);
+      const int64_t tl = r.first.secondsSinceJan1970();
+      const int64_t th = r.second.secondsSinceJan1970();
+      for (size_t n = 0; n < times_.size(); n++) {
+        if (times_[n] <= tl || times_[n] > th) continue;
+        const double w = (from_[n] == tc ? 1.0 - alpha_[n] : 0.0) +
+                         (to_[n] == tc ? alpha_[n] : 0.0);
+        x[n] = w * y[n];
+      }
+    }
+
+   private:
+    static int64_t none() { return std::numeric_limits<int64_t>::min(); }
+
+    bool linear_;
+    std::vector<int64_t> times_;
+
+    // for each location, the state it starts from and the state it is
+    // blended towards (none() for the nearest state) with its weight, and
+    // the pass that set them
+    std::vector<int64_t> from_;
+    std::vector<int64_t> to_;
+    std::vector<double> alpha_;
+    std::vector<int> fromPass_;
+
+    int pass_;
+    bool inPass_;
+    util::DateTime last_;
+    std::map<int64_t, std::pair<util::DateTime, util::DateTime>> ranges_;
+  };
+}  // namespace umdsst
+
+#endif  // UMDSST_GETVALUES_TIMEINTERPOLATION_H_
@@ -0,0 +1,110 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <vector>
+
+#include "umdsst/Geometry/Geometry.h"
+#include "umdsst/GetValues/UnstructuredInterpolator.h"
+
+#include "eckit/config/LocalConfiguration.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
+#include "atlas/functionspace.h"
+#include "atlas/option.h"
+
+#include "oops/generic/InterpolatorUnstructured.h"
+
+using atlas::array::make_view;
+
+namespace umdsst {
+
+// ----------------------------------------------------------------------------
+
+  UnstructuredInterpolator::UnstructuredInterpolator(
+    const Geometry & geom, const atlas::FunctionSpace & locations,
+    const std::vector<util::DateTime> & times) : locations_(locations) {
+    interpolator_.reset(new oops::InterpolatorUnstructured(
+                              eckit::LocalConfiguration(),
+                              *geom.atlasFunctionSpace(), locations));
+    for (const util::DateTime & t : times)
+      times_.push_back(t.secondsSinceJan1970());
+
+    // the land mask as a floating point field, all ocean without one
+    seaFraction_ = geom.atlasFunctionSpace()->createField<double>(
+      atlas::option::levels(1));
+    auto fd = make_view<double, 2>(seaFraction_);
+    fd.assign(1.0);
+    if (geom.atlasFieldSet()->has_field("gmask")) {
+      auto mask = make_view<int, 2>(geom.atlasFieldSet()->field("gmask"));
+      for (size_t k = 0; k < static_cast<size_t>(fd.shape(0)); k++)
+        fd(k, 0) = static_cast<double>(mask(k, 0));
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  UnstructuredInterpolator::~UnstructuredInterpolator() {}
+
+// ----------------------------------------------------------------------------
+
+  void UnstructuredInterpolator::apply(const atlas::Field & src,
+                                       atlas::Field & dst,
+                                       const util::DateTime &,
+                                       const util::DateTime &) const {
+    interpolator_->apply(src, dst);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void UnstructuredInterpolator::applyTL(const atlas::Field & src,
+                                         atlas::Field & dst,
+                                         const util::DateTime &,
+                                         const util::DateTime &) const {
+    interpolator_->apply(src, dst);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void UnstructuredInterpolator::applyAD(const atlas::Field & src,
+                                         atlas::Field & dst,
+                                         const util::DateTime & t1,
+                                         const util::DateTime & t2) const {
+    // the values of the slot only, the others are zero
+    if (!work_ || work_.levels() != src.levels())
+      work_ = locations_.createField<double>(
+        atlas::option::levels(src.levels()));
+    const int64_t s1 = t1.secondsSinceJan1970();
+    const int64_t s2 = t2.secondsSinceJan1970();
+    const int nlev = src.levels();
+    const double * x = make_view<double, 2>(src).data();
+    double * y = make_view<double, 2>(work_).data();
+    for (size_t n = 0; n < times_.size(); n++) {
+      const bool inSlot = times_[n] > s1 && times_[n] <= s2;
+      for (int l = 0; l < nlev; l++)
+        y[n*nlev + l] = inSlot ? x[n*nlev + l] : 0.0;
+    }
+    interpolator_->apply_ad(work_, dst);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void UnstructuredInterpolator::seaAreaFraction(
+    atlas::Field & dst, const util::DateTime &,
+    const util::DateTime &) const {
+    interpolator_->apply(seaFraction_, dst);
+  }
+
+// ----------------------------------------------------------------------------
+
+  void UnstructuredInterpolator::print(std::ostream & os) const {
+    os << "UnstructuredInterpolator: " << times_.size() << " locations";
+  }
+
+// ----------------------------------------------------------------------------
+
+}  // namespace umdsst
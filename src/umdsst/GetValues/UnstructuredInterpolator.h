@@ -0,0 +1,67 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_GETVALUES_UNSTRUCTUREDINTERPOLATOR_H_
+#define UMDSST_GETVALUES_UNSTRUCTUREDINTERPOLATOR_H_
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "umdsst/GetValues/InterpolatorBase.h"
+
+#include "atlas/field.h"
+#include "atlas/functionspace.h"
+
+#include "oops/util/DateTime.h"
+
+// forward declarations
+namespace oops {
+  class InterpolatorUnstructured;
+}
+namespace umdsst {
+  class Geometry;
+}
+
+// ----------------------------------------------------------------------------
+
+namespace umdsst {
+
+  // The generic unstructured interpolation of oops, from the grid points to
+  // the locations (the atlas PointCloud of the LocationsWrapper). The
+  // applies go through all the locations, whatever the time slot, and the
+  // adjoint leaves out the locations outside of the slot. Land points are
+  // interpolated as they are, missing values included.
+  class UnstructuredInterpolator : public InterpolatorBase {
+   public:
+    UnstructuredInterpolator(const Geometry &, const atlas::FunctionSpace &,
+                             const std::vector<util::DateTime> &);
+    ~UnstructuredInterpolator();
+
+    void apply(const atlas::Field &, atlas::Field &, const util::DateTime &,
+               const util::DateTime &) const override;
+    void applyTL(const atlas::Field &, atlas::Field &, const util::DateTime &,
+                 const util::DateTime &) const override;
+    void applyAD(const atlas::Field &, atlas::Field &, const util::DateTime &,
+                 const util::DateTime &) const override;
+    void seaAreaFraction(atlas::Field &, const util::DateTime &,
+                         const util::DateTime &) const override;
+
+   private:
+    void print(std::ostream &) const override;
+
+    std::unique_ptr<oops::InterpolatorUnstructured> interpolator_;
+    atlas::FunctionSpace locations_;
+    std::vector<int64_t> times_;
+    atlas::Field seaFraction_;  // "gmask" as double, on the grid
+    mutable atlas::Field work_;  // the locations of the slot for the adjoint
+  };
+
+}  // namespace umdsst
+
+#endif  // UMDSST_GETVALUES_UNSTRUCTUREDINTERPOLATOR_H_
@@ -5,11 +5,13 @@
  * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
  */
 
+#include <utility>
 #include <vector>
 
 #include "umdsst/Geometry/Geometry.h"
 #include "umdsst/Increment/Increment.h"
 #include "umdsst/State/State.h"
+#include "umdsst/Utils/Philox.h"
 
 #include "eckit/config/Configuration.h"
 
@@ -20,7 +22,6 @@
 #include "oops/mpi/mpi.h"
 #include "oops/util/abor1_cpp.h"
 #include "oops/util/Logger.h"
-#include "oops/util/Random.h"
 
 using atlas::array::make_view;
 
@@ -45,16 +46,18 @@ namespace umdsst {
 // ----------------------------------------------------------------------------
 
   Increment::Increment(const Increment & other, const bool copy)
-    : Fields(*other.geom_, other.vars_, other.time_) {
-    if (copy)
-      *this = other;
-  }
+    : Fields(other, copy) {}
 
 // ----------------------------------------------------------------------------
 
   Increment::Increment(const Increment & other)
     : Fields(other) {}
 
+// ----------------------------------------------------------------------------
+
+  Increment::Increment(Increment && other)
+    : Fields(std::move(other)) {}
+
 // ----------------------------------------------------------------------------
 
   Increment::~Increment() { }
@@ -71,16 +74,15 @@ namespace umdsst {
 
 // ----------------------------------------------------------------------------
 
-  Increment & Increment::operator -=(const Increment &other) {
-    const int size = geom_->atlasFunctionSpace()->size();
+  Increment & Increment::operator =(Increment &&other) {
+    Fields::operator=(std::move(other));
+    return *this;
+  }
 
-    for (int i = 0; i < vars_.size(); i++) {
-      auto fd       = make_view<double, 2>(atlasFieldSet_->field(0));
-      auto fd_other = make_view<double, 2>(other.atlasFieldSet()->field(0));
-      for (int j = 0; j < size; j++)
-        fd(j, 0) -= fd_other(j, 0);
-    }
+// ----------------------------------------------------------------------------
 
+  Increment & Increment::operator -=(const Increment &other) {
+    binaryOp(other, [](double & x, const double & y) { x -= y; });
     return *this;
   }
 
@@ -94,12 +96,7 @@ namespace umdsst {
 // ----------------------------------------------------------------------------
 
   Increment & Increment::operator *=(const double &zz) {
-    auto fd       = make_view<double, 2>(atlasFieldSet_->field(0));
-    const int size = geom_->atlasFunctionSpace()->size();
-
-    for (int j = 0; j < size; j++)
-      fd(j, 0) *= zz;
-
+    unaryOp([zz](double & x) { x *= zz; });
     return *this;
   }
 
@@ -116,28 +113,27 @@ namespace umdsst {
 // ----------------------------------------------------------------------------
 
   void Increment::diff(const State & x1, const State & x2) {
-    auto fd = make_view<double, 2>(atlasFieldSet_->field(0));
-    auto fd_x1 = make_view<double, 2>(x1.atlasFieldSet()->field(0));
-    auto fd_x2 = make_view<double, 2>(x2.atlasFieldSet()->field(0));
-
-    const int size = geom_->atlasFunctionSpace()->size();
-
-    for (int i = 0; i < size; i++)
-      fd(i, 0) = fd_x1(i, 0) - fd_x2(i, 0);
+    for (size_t v = 0; v < fieldData_.size(); v++) {
+      double * fd = fieldData_[v];
+      const double * fd_x1 = x1.fieldData(vars_[v]);
+      const double * fd_x2 = x2.fieldData(vars_[v]);
+      for (size_t i = 0; i < fieldSize_[v]; i++)
+        fd[i] = fd_x1[i] - fd_x2[i];
+    }
   }
 
 // ----------------------------------------------------------------------------
 
   double Increment::dot_product_with(const Increment &other) const {
-    auto fd = make_view<double, 2>(atlasFieldSet_->field(0));
-    auto fd_other = make_view<double, 2>(other.atlasFieldSet()->field(0));
-
-    const int size = geom_->atlasFunctionSpace()->size();
     double dp = 0.0;
 
     // Ligang: will be updated with missing_value process!
-    for (int i = 0; i < size; i++)
-      dp += fd(i, 0)*fd_other(i, 0);
+    for (size_t v = 0; v < fieldData_.size(); v++) {
+      const double * fd = fieldData_[v];
+      const double * fd_other = other.fieldData(vars_[v]);
+      for (size_t i = 0; i < fieldSize_[v]; i++)
+        dp += fd[i]*fd_other[i];
+    }
 
     // sum results across PEs
     oops::mpi::world().allReduceInPlace(dp, eckit::mpi::Operation::SUM);
@@ -148,43 +144,41 @@ namespace umdsst {
 // ----------------------------------------------------------------------------
 
   void Increment::ones() {
-    auto fd = make_view<double, 2>(atlasFieldSet_->field(0));
-    fd.assign(1.0);
+    unaryOp([](double & x) { x = 1.0; });
   }
 
 // ----------------------------------------------------------------------------
 
-  void Increment::random() {
-    auto fd = make_view<double, 2>(atlasFieldSet_->field(0));
-    const int size = geom_->atlasFunctionSpace()->size();
-
-    util::NormalDistribution<double> x(size, 0, 1.0, 1);
+  void Increment::random(const size_t member, const size_t seed) {
+    // The random numbers are keyed by the global index of each point, not
+    // by the order in which this PE happens to hold them.
+    const Philox rng(seed);
+    auto gidx = make_view<atlas::gidx_t, 1>(
+      geom_->atlasFunctionSpace()->global_index());
 
-    for (int i = 0; i < size; i++)
-      fd(i, 0) = x[i];
+    for (size_t v = 0; v < fieldData_.size(); v++) {
+      double * fd = fieldData_[v];
+      const int nlev = fieldLevels_[v];
+      const int ncol = fieldSize_[v] / nlev;
+#pragma omp parallel for
+      for (int j = 0; j < ncol; j++)
+        for (int k = 0; k < nlev; k++)
+          fd[j*nlev + k] = rng.normal(gidx(j), k, v, member);
+    }
   }
 
 // ----------------------------------------------------------------------------
 
   void Increment::schur_product_with(const Increment &rhs ) {
-    auto fd = make_view<double, 2>(atlasFieldSet_->field(0));
-    auto fd_rhs = make_view<double, 2>(rhs.atlasFieldSet()->field(0));
-
-    const int size = geom_->atlasFunctionSpace()->size();
-    for (int i = 0; i < size; i++)
-      fd(i, 0) *= fd_rhs(i, 0);
+    binaryOp(rhs, [](double & x, const double & y) { x *= y; });
   }
 
 // ----------------------------------------------------------------------------
 
   void Increment::schur_product_with_inv(const Increment &rhs ) {
-    auto fd = make_view<double, 2>(atlasFieldSet_->field(0));
-    auto fd_rhs = make_view<double, 2>(rhs.atlasFieldSet()->field(0));
-
-    const int size = geom_->atlasFunctionSpace()->size();
-    for (int i = 0; i < size; i++)
-      fd(i, 0) *= 1.0 / fd_rhs(i, 0);
+    binaryOp(rhs, [](double & x, const double & y) { x *= 1.0 / y; });
   }
+
 // ----------------------------------------------------------------------------
 
   void Increment::zero() {
@@ -219,41 +213,15 @@ namespace umdsst {
     for (int i = 0; i < dir_size; i++)
       ASSERT(ixdir[i] < nx && iydir[i] < ny);
 
-    atlas::Field gi = geom_->atlasFunctionSpace()->global_index();
-    atlas::Field ri = geom_->atlasFunctionSpace()->remote_index();
-    auto fd_gi = make_view<int64_t, 1>(gi);
-    auto fd_ri = make_view<int, 1>(ri);
-
-    const int sz = geom_->atlasFunctionSpace()->size();
-
-    auto fd = make_view<double, 2>(atlasFieldSet_->field(0));
+    // Set the diracs on the points owned by this PE, each point is found in
+    // constant time with the global (i, j) to local index map of the geometry
     for (int i = 0; i < dir_size; i++) {
-      // Ligang: 2D to 1D global_index, the 1D global_index starts from 1, which
-      // is normally oriented to user; while 1D remote_index and the 2D
-      // specification start from 0 and (0,0) (as in ncview), which is kind
-      // oriented to C++ programming. The relationship below is only for our
-      // simple case (grid), need to dig deep in how atlas store globa_indices.
-      int g_idx = iydir[i]*nx + ixdir[i] + 1;
-
-      // Use if below to avoid unnecessary search.
-      if (fd_gi(0) <= g_idx && g_idx <= fd_gi(sz-1)) {
-        // Find the corresponding remote_index to the global g_idx on this CPU.
-        // If we know for sure the array fd_gi() is increasing, we can use more
-        // efficient algorithm for search.
-        int j_loc = 0;
-        for (j_loc = 0; j_loc < sz; j_loc++) {
-          if (fd_gi(j_loc) == g_idx)
-            break;
-        }
-        if (j_loc >= sz) {
-          util::abor1_cpp("Increment::dirac(), failed to find global idx.",
-                           __FILE__, __LINE__);
-        } else {
-          // The arrays of globa/remote index should be matching.
-          int r_idx = fd_ri(j_loc);
-          fd(r_idx, 0) = 1.0;
-        }
-      }
+      const int idx = geom_->localIndex(ixdir[i], iydir[i]);
+      if (idx < 0)
+        continue;
+      for (size_t v = 0; v < fieldData_.size(); v++)
+        for (int k = 0; k < fieldLevels_[v]; k++)
+          fieldData_[v][idx*fieldLevels_[v] + k] = 1.0;
     }
   }
 
@@ -41,6 +41,7 @@ namespace umdsst {
     Increment(const Geometry &, const Increment &);
     Increment(const Increment &, const bool);
     Increment(const Increment &);
+    Increment(Increment &&);
     ~Increment();
 
     // wrappers of methods that are fully implemented in Fields
@@ -48,13 +49,16 @@ namespace umdsst {
 
     // Math operators
     Increment & operator =(const Increment &);
+    Increment & operator =(Increment &&);
     Increment & operator-=(const Increment &);
     Increment & operator*=(const double &);
     void axpy(const double &, const Increment &, const bool check = true);
     void diff(const State &, const State &);
     double dot_product_with(const Increment &) const;
     void ones();
-    void random();
+    // a N(0,1) random field, which is the same on any number of PEs for a
+    // given member and seed
+    void random(const size_t member = 0, const size_t seed = 1);
     void schur_product_with(const Increment &);
     void schur_product_with_inv(const Increment &);
     void zero();
@@ -5,17 +5,60 @@
  * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
 #include "umdsst/LinearVariableChange/StdDev.h"
 #include "umdsst/State/State.h"
 #include "umdsst/Geometry/Geometry.h"
 #include "umdsst/Traits.h"
 #include "umdsst/Increment/Increment.h"
+#include "umdsst/Utils/Gradient.h"
+
+#include "eckit/config/Configuration.h"
+#include "eckit/config/LocalConfiguration.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
 
 #include "oops/interface/LinearVariableChange.h"
 #include "oops/util/abor1_cpp.h"
+#include "oops/util/Logger.h"
+#include "oops/util/missingValues.h"
+
+using atlas::array::make_view;
 
 namespace umdsst {
 
+namespace {
+  const char sstName[] = "sea_surface_temperature";
+
+  double * data(const Increment & dx, const std::string & var) {
+    return make_view<double, 2>(dx.atlasFieldSet()->field(var)).data();
+  }
+
+  // 1 for ocean points, 0 for land points of the landmask and points where
+  // the field read in is missing
+  std::vector<int> oceanMask(const Geometry & geom, const double * x,
+                             const size_t n) {
+    const double missing = util::missingValue(missing);
+    std::vector<int> ocean(n, 1);
+    if (geom.atlasFieldSet()->has_field("gmask")) {
+      const int * gmask = make_view<int, 2>(
+        geom.atlasFieldSet()->field("gmask")).data();
+      for (size_t k = 0; k < n; k++)
+        if (gmask[k] == 0) ocean[k] = 0;
+    }
+    if (x != nullptr)
+      for (size_t k = 0; k < n; k++)
+        if (x[k] == missing) ocean[k] = 0;
+    return ocean;
+  }
+}  // namespace
+
 // ----------------------------------------------------------------------------
 
 StdDev::StdDev(const State &bkg, const State &traj, const Geometry &geom,
@@ -23,25 +66,185 @@ StdDev::StdDev(const State &bkg, const State &traj, const Geometry &geom,
   stddev_.reset(new Increment(geom, bkg.variables(), bkg.validTime()));
   stddev_->ones();
 
+  const bool hasSource = conf.has("file") || conf.has("sst gradient") ||
+                         conf.has("ensemble");
   if ( conf.has("fixed") ) {
-    // a single global fixed value
+    // a single global fixed value, also used for the variables that the
+    // other sources do not provide and for their land points
     double val;
     conf.get("fixed", val);
     *stddev_ *= val;
-  } else {
+    source_ = "fixed " + std::to_string(val);
+  } else if ( !hasSource ) {
     util::abor1_cpp("StdDev::StdDev() no standard deviation "
                     "method specified", __FILE__, __LINE__);
   }
 
-  // TODO(someone) place the real horizontally varying background error
-  // standard deviation in stddev_
+  if ( hasSource && !bkg.variables().has(sstName) )
+    util::abor1_cpp("StdDev::StdDev() the file, sst gradient and ensemble "
+                    "standard deviations need sea_surface_temperature",
+                    __FILE__, __LINE__);
+  std::vector<int> ocean;
+  if ( conf.has("file") ) {
+    ocean = fromFile(eckit::LocalConfiguration(conf, "file"));
+    source_ = "file";
+  } else if ( conf.has("sst gradient") ) {
+    ocean = fromGradient(bkg, geom,
+                         eckit::LocalConfiguration(conf, "sst gradient"));
+    source_ = "sst gradient";
+  } else if ( conf.has("ensemble") ) {
+    ocean = fromEnsemble(geom, eckit::LocalConfiguration(conf, "ensemble"));
+    source_ = "ensemble";
+  }
+
+  // bounds on the ocean values of sigma, including the ocean points where
+  // the source gives 0
+  if ( hasSource ) {
+    const double minVal = conf.getDouble("min value", 0.0);
+    const double maxVal = conf.getDouble("max value",
+                                         std::numeric_limits<double>::max());
+    double * s = data(*stddev_, sstName);
+    for (size_t i = 0; i < ocean.size(); i++)
+      if (ocean[i]) s[i] = std::min(std::max(s[i], minVal), maxVal);
+  }
+
+  // the pseudo-inverse, so that multiplyInverse does not have to divide
+  invStddev_.reset(new Increment(*stddev_));
+  const oops::Variables & vars = stddev_->variables();
+  for (size_t v = 0; v < vars.size(); v++) {
+    const double * s = stddev_->fieldData(vars[v]);
+    double * is = data(*invStddev_, vars[v]);
+    const size_t n = stddev_->atlasFieldSet()->field(vars[v]).size();
+    for (size_t i = 0; i < n; i++)
+      is[i] = s[i] != 0.0 ? 1.0 / s[i] : 0.0;
+  }
+
+  oops::Log::info() << "StdDev: " << *this << std::endl;
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<int> StdDev::fromFile(const eckit::Configuration &conf) {
+  // read as a field in the same format as the background, without the
+  // kelvin conversion
+  eckit::LocalConfiguration fileConf(conf);
+  fileConf.set("kelvin", false);
+  Increment dx(*stddev_, false);
+  dx.read(fileConf);
+
+  const atlas::Field fld = dx.atlasFieldSet()->field(sstName);
+  const double * x = dx.fieldData(sstName);
+  const std::vector<int> ocean = oceanMask(*dx.geometry(), x, fld.size());
+  double * s = data(*stddev_, sstName);
+  for (size_t k = 0; k < ocean.size(); k++)
+    if (ocean[k]) s[k] = std::abs(x[k]);
+  return ocean;
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<int> StdDev::fromGradient(const State &bkg, const Geometry &geom,
+                          const eckit::Configuration &conf) {
+  // sigma = base + mult |grad SST|, so that the errors are larger near the
+  // fronts. The gradient is in K/m, and "gradient mult" is in m: sigma grows
+  // by the change of the SST over that distance. Centered differences,
+  // one-sided next to land and the poles.
+  const double base = conf.getDouble("base value", 0.0);
+  const double mult = conf.getDouble("gradient mult", 0.0);
+
+  const double * sst = bkg.fieldData(sstName);
+  const size_t n = bkg.atlasFieldSet()->field(sstName).size();
+  const std::vector<int> ocean = oceanMask(geom, sst, n);
+  std::vector<double> gx, gy;
+  horizontalGradient(geom, sst, ocean, gx, gy);
+
+  double * s = data(*stddev_, sstName);
+  for (size_t k = 0; k < n; k++)
+    if (ocean[k]) s[k] = base + mult * std::sqrt(gx[k]*gx[k] + gy[k]*gy[k]);
+  return ocean;
+}
+
+// ----------------------------------------------------------------------------
+
+std::vector<int> StdDev::fromEnsemble(const Geometry &geom,
+                          const eckit::Configuration &conf) {
+  // sigma = inflation * the spread of the members, accumulated one member at
+  // a time (Welford) so that only one member is held in memory
+  const std::vector<eckit::LocalConfiguration> members =
+    conf.getSubConfigurations("members");
+  if (members.size() < 2)
+    util::abor1_cpp("StdDev::fromEnsemble() at least 2 members needed",
+                    __FILE__, __LINE__);
+  const double inflation = conf.getDouble("inflation", 1.0);
+
+  Increment member(*stddev_, false);
+  const size_t n = member.atlasFieldSet()->field(sstName).size();
+  std::vector<double> mean(n, 0.0), m2(n, 0.0);
+  std::vector<int> ocean(n, 1);
+  for (size_t m = 0; m < members.size(); m++) {
+    eckit::LocalConfiguration memberConf(members[m]);
+    if (!memberConf.has("kelvin"))
+      memberConf.set("kelvin", conf.getBool("kelvin", false));
+    member.read(memberConf);
+    const double * x = member.fieldData(sstName);
+    const std::vector<int> memberOcean = oceanMask(geom, x, n);
+    for (size_t k = 0; k < n; k++) {
+      ocean[k] = ocean[k] && memberOcean[k];
+      if (!ocean[k]) continue;
+      const double d = x[k] - mean[k];
+      mean[k] += d / (m+1);
+      m2[k] += d * (x[k] - mean[k]);
+    }
+  }
+
+  double * s = data(*stddev_, sstName);
+  for (size_t k = 0; k < n; k++)
+    if (ocean[k]) s[k] = inflation * std::sqrt(m2[k] / (members.size()-1));
+  return ocean;
+}
+
+// ----------------------------------------------------------------------------
+
+void StdDev::scale(const Increment &s, const Increment &dxin,
+                   Increment &dxout) const {
+  // dxout = s * dxin, without first copying dxin to dxout
+  const oops::Variables & vars = dxin.variables();
+  for (size_t v = 0; v < vars.size(); v++) {
+    const size_t n = dxin.atlasFieldSet()->field(vars[v]).size();
+    const double * x = dxin.fieldData(vars[v]);
+    const double * sv = s.fieldData(vars[v]);
+    double * y = data(dxout, vars[v]);
+#pragma omp parallel for
+    for (size_t i = 0; i < n; i++)
+      y[i] = sv[i] * x[i];
+  }
+  dxout.validTime() = dxin.validTime();
+}
+
+// ----------------------------------------------------------------------------
+
+void StdDev::apply(atlas::FieldSet &fset, const bool inverse) const {
+  const Increment & s = inverse ? *invStddev_ : *stddev_;
+  const oops::Variables & vars = s.variables();
+  for (int f = 0; f < fset.size(); f++) {
+    atlas::Field fld = fset[f];
+    if (!vars.has(fld.name())) continue;
+    const double * sv = s.fieldData(fld.name());
+    const int nlevS = s.atlasFieldSet()->field(fld.name()).levels();
+    const int nlev = fld.levels();
+    const int npts = fld.shape(0);
+    double * x = make_view<double, 2>(fld).data();
+#pragma omp parallel for
+    for (int k = 0; k < npts; k++)
+      for (int l = 0; l < nlev; l++)
+        x[k*nlev + l] *= sv[k*nlevS + l % nlevS];
+  }
 }
 
 // ----------------------------------------------------------------------------
 
 void StdDev::multiply(const Increment &dxin, Increment &dxout) const {
-  dxout = dxin;
-  dxout.schur_product_with(*stddev_);
+  scale(*stddev_, dxin, dxout);
 }
 
 // ----------------------------------------------------------------------------
@@ -53,8 +256,7 @@ void StdDev::multiplyAD(const Increment &dxin, Increment &dxout) const {
 // ----------------------------------------------------------------------------
 
 void StdDev::multiplyInverse(const Increment &dxin, Increment &dxout) const {
-  dxout = dxin;
-  dxout.schur_product_with_inv(*stddev_);
+  scale(*invStddev_, dxin, dxout);
 }
 
 // ----------------------------------------------------------------------------
@@ -65,6 +267,12 @@ void StdDev::multiplyInverseAD(const Increment &dxin, Increment &dxout) const {
 
 // ----------------------------------------------------------------------------
 
+void StdDev::print(std::ostream &os) const {
+  os << "standard deviation from " << source_;
+}
+
+// ----------------------------------------------------------------------------
+
 oops::LinearVariableChangeMaker<Traits,
                                 oops::LinearVariableChange<Traits, StdDev> >
   makerLinearVariableChangeStdDev_("umdsstStdDev");
@@ -9,11 +9,16 @@
 #define UMDSST_LINEARVARIABLECHANGE_STDDEV_H_
 
 #include <memory>
+#include <ostream>
 #include <string>
+#include <vector>
 
 #include "oops/util/Printable.h"
 
 // Forward Declaration
+namespace atlas {
+  class FieldSet;
+}
 namespace eckit {
   class Configuration;
 }
@@ -25,6 +30,14 @@ namespace umdsst {
 
 namespace umdsst {
 
+// The background error standard deviation sigma, a diagonal operator. sigma
+// is "fixed" for all the variables, and the SST can instead be read from a
+// "file", derived from the "sst gradient" of the background or from the
+// spread of an "ensemble". Those sources only set the ocean points, where
+// sigma is bounded by "min value" and "max value". Land points keep the
+// fixed value (1 without one): the correlations are 0 there, so it only
+// keeps sigma invertible. sigma and its pseudo-inverse (0 where sigma is 0)
+// are computed once at construction.
 class StdDev: public util::Printable {
  public:
   static const std::string classname() {return "umdsst:StdDev";}
@@ -37,9 +50,29 @@ class StdDev: public util::Printable {
   void multiplyAD(const Increment &, Increment &) const;
   void multiplyInverseAD(const Increment &, Increment &) const;
 
+  // sigma or 1/sigma in place on the fields of a FieldSet that have a
+  // standard deviation. A field can have several copies of the levels of
+  // sigma (e.g. the members of a batch packed as levels), sigma is applied
+  // to each of them.
+  void apply(atlas::FieldSet &, const bool inverse) const;
+
  private:
-  void print(std::ostream &) const override {}
+  void print(std::ostream &) const override;
+
+  // SST sources, overwriting the ocean points of sigma, which they return
+  // the mask of
+  std::vector<int> fromFile(const eckit::Configuration &);
+  std::vector<int> fromGradient(const State &, const Geometry &,
+                                const eckit::Configuration &);
+  std::vector<int> fromEnsemble(const Geometry &,
+                                const eckit::Configuration &);
+
+  // y = s x for all the variables, in one pass
+  void scale(const Increment &, const Increment &, Increment &) const;
+
+  std::string source_;
   std::unique_ptr<Increment> stddev_;
+  std::unique_ptr<Increment> invStddev_;
 };
 
 }  // namespace umdsst
@@ -4,6 +4,9 @@
  * This software is licensed under the terms of the Apache Licence Version 2.0
  * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
  */
+
+#include <utility>
+
 #include "umdsst/Geometry/Geometry.h"
 #include "umdsst/Increment/Increment.h"
 #include "umdsst/State/State.h"
@@ -45,10 +48,29 @@ namespace umdsst {
   State::State(const State & other)
     : Fields(other) {}
 
+// ----------------------------------------------------------------------------
+
+  State::State(State && other)
+    : Fields(std::move(other)) {}
+
 // ----------------------------------------------------------------------------
 
   State::~State() {}
 
+// ----------------------------------------------------------------------------
+
+  State & State::operator =(const State & other) {
+    Fields::operator=(other);
+    return *this;
+  }
+
+// ----------------------------------------------------------------------------
+
+  State & State::operator =(State && other) {
+    Fields::operator=(std::move(other));
+    return *this;
+  }
+
 // ----------------------------------------------------------------------------
 
   State & State::operator+=(const Increment & dx) {
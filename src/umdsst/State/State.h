@@ -46,9 +46,12 @@ namespace umdsst {
           const util::DateTime &);
     State(const Geometry &, const State &);
     State(const State &);
+    State(State &&);
     ~State();
 
     // wrappers of methods that are fully implemented in Fields
+    State & operator =(const State &);
+    State & operator =(State &&);
     State & operator+=(const Increment &);
   };
 }  // namespace umdsst
@@ -0,0 +1,216 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "umdsst/Geometry/Geometry.h"
+#include "umdsst/SuperOb/SuperOb.h"
+#include "umdsst/Utils/GridCells.h"
+
+#include "eckit/config/Configuration.h"
+#include "eckit/config/LocalConfiguration.h"
+#include "eckit/mpi/Comm.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
+#include "atlas/functionspace.h"
+#include "atlas/grid.h"
+
+#include "ioda/ObsSpace.h"
+
+#include "oops/mpi/mpi.h"
+#include "oops/util/abor1_cpp.h"
+#include "oops/util/DateTime.h"
+#include "oops/util/Duration.h"
+#include "oops/util/Logger.h"
+#include "oops/util/missingValues.h"
+
+using atlas::array::make_view;
+
+namespace umdsst {
+
+namespace {
+  // the values sent with each observation to the PE of its bin: the global
+  // index of the grid point, the value, the variance of its error and its
+  // time in seconds from the beginning of the window
+  const int nsend = 4;
+
+  // the values of each superobservation: latitude, longitude, time, value,
+  // error, count and spread
+  const int nsuper = 7;
+
+  // running moments of the observations of the bins (Welford, 1962), and
+  // the sums of their error variances and times
+  struct Bins {
+    explicit Bins(const size_t size)
+      : n(size, 0), gid(size, -1), mean(size, 0.0), m2(size, 0.0),
+        err2(size, 0.0), time(size, 0.0) {}
+    void add(const size_t k, const int g, const double x, const double e2,
+             const double t) {
+      gid[k] = g;
+      n[k]++;
+      const double d = x - mean[k];
+      mean[k] += d / n[k];
+      m2[k] += d * (x - mean[k]);
+      err2[k] += e2;
+      time[k] += t;
+    }
+    double spread(const size_t k) const {
+      return n[k] > 1 ? std::sqrt(m2[k] / (n[k] - 1)) : 0.0;
+    }
+    std::vector<int> n, gid;
+    std::vector<double> mean, m2, err2, time;
+  };
+}  // namespace
+
+// ----------------------------------------------------------------------------
+
+  int SuperOb::execute(const eckit::Configuration & fullConfig) const {
+    const eckit::mpi::Comm & comm = getComm();
+    const Geometry geom(eckit::LocalConfiguration(fullConfig, "geometry"),
+                        comm);
+    const util::DateTime winbgn(fullConfig.getString("window begin"));
+    const util::DateTime winend(
+      winbgn + util::Duration(fullConfig.getString("window length")));
+    const std::string var = fullConfig.getString("variable",
+                                                 "sea_surface_temperature");
+    const int minCount = fullConfig.getInt("minimum count", 1);
+    if (minCount < 1)
+      util::abor1_cpp("SuperOb::execute(), \"minimum count\" must be "
+                      "positive", __FILE__, __LINE__);
+    const double missing = util::missingValue(missing);
+
+    // the observations of this PE
+    const ioda::ObsSpace obsin(eckit::LocalConfiguration(fullConfig, "input"),
+                               comm, winbgn, winend);
+    const size_t nobs = obsin.nlocs();
+    std::vector<double> lats(nobs), lons(nobs), vals(nobs), errs(nobs);
+    std::vector<util::DateTime> times(nobs);
+    obsin.get_db("MetaData", "latitude", lats);
+    obsin.get_db("MetaData", "longitude", lons);
+    obsin.get_db("MetaData", "datetime", times);
+    obsin.get_db("ObsValue", var, vals);
+    obsin.get_db("ObsError", var, errs);
+    std::vector<int> qc(nobs, 0);
+    const int maxQc = fullConfig.getInt("max preqc", 0);
+    if (fullConfig.has("max preqc"))
+      obsin.get_db("PreQC", var, qc);
+
+    // the bin of each observation, and the PE that owns it
+    const atlas::functionspace::StructuredColumns & fs =
+      *geom.atlasFunctionSpace();
+    const atlas::RegularLonLatGrid grid(fs.grid());
+    const int nx = grid.nx();
+    const GridCells cells(grid);
+    const PointOwners owners(fs, comm);
+    std::vector<int> gid(nobs, -1), owner(nobs, -1);
+#pragma omp parallel for
+    for (int n = 0; n < static_cast<int>(nobs); n++) {
+      if (vals[n] == missing || errs[n] == missing || qc[n] > maxQc)
+        continue;
+      const Cell c = cells.cell(lons[n], lats[n]);
+      gid[n] = c.j()*nx + c.i();
+      owner[n] = owners.owner(c.i(), c.j());
+    }
+
+    const size_t npe = comm.size();
+    std::vector<std::vector<double>> sendBuf(npe), recvBuf(npe);
+    for (size_t n = 0; n < nobs; n++) {
+      if (owner[n] < 0) continue;
+      std::vector<double> & buf = sendBuf[owner[n]];
+      buf.push_back(gid[n]);
+      buf.push_back(vals[n]);
+      buf.push_back(errs[n]*errs[n]);
+      buf.push_back((times[n] - winbgn).toSeconds());
+    }
+    comm.allToAll(sendBuf, recvBuf);
+
+    // the bins of the grid points of this PE
+    Bins bins(fs.size());
+    size_t nused = 0;
+    for (size_t p = 0; p < npe; p++)
+      for (size_t m = 0; m < recvBuf[p].size(); m += nsend) {
+        const double * r = &recvBuf[p][m];
+        const int g = static_cast<int>(r[0]);
+        bins.add(geom.localIndex(g % nx, g / nx), g, r[1], r[2], r[3]);
+        nused++;
+      }
+
+    // the superobservations of this PE, over the ocean only
+    const int * gmask = geom.atlasFieldSet()->has_field("gmask") ?
+      make_view<int, 2>(geom.atlasFieldSet()->field("gmask")).data() :
+      nullptr;
+    std::vector<double> mySuper;
+    for (size_t k = 0; k < bins.n.size(); k++) {
+      const int n = bins.n[k];
+      if (n < minCount || (gmask != nullptr && gmask[k] == 0)) continue;
+      const double spread = bins.spread(k);
+      mySuper.push_back(grid.y(bins.gid[k] / nx));
+      mySuper.push_back(grid.x(bins.gid[k] % nx));
+      mySuper.push_back(bins.time[k] / n);
+      mySuper.push_back(bins.mean[k]);
+      mySuper.push_back(std::sqrt((bins.err2[k] / n + spread*spread) / n));
+      mySuper.push_back(n);
+      mySuper.push_back(spread);
+    }
+
+    // the output is a single file, so the superobservations of the bins are
+    // gathered on the first PE only, which writes them
+    std::vector<std::vector<double>> sendSuper(npe), recvSuper(npe);
+    sendSuper[0] = mySuper;
+    comm.allToAll(sendSuper, recvSuper);
+    comm.allReduceInPlace(nused, eckit::mpi::Operation::SUM);
+    if (comm.rank() > 0) return 0;
+
+    std::vector<double> super;
+    for (const std::vector<double> & s : recvSuper)
+      super.insert(super.end(), s.begin(), s.end());
+    const size_t nout = super.size() / nsuper;
+    oops::Log::info() << "SuperOb: " << nused << " observations in " << nout
+                      << " superobservations" << std::endl;
+
+    std::vector<double> outLats(nout), outLons(nout), outVals(nout),
+                        outErrs(nout), outSpread(nout);
+    std::vector<std::string> outTimes(nout);
+    std::vector<int> outCount(nout), outQc(nout, 0);
+    for (size_t s = 0; s < nout; s++) {
+      const double * r = &super[s*nsuper];
+      outLats[s] = r[0];
+      outLons[s] = r[1];
+      outTimes[s] = (winbgn + util::Duration(std::llround(r[2]))).toString();
+      outVals[s] = r[3];
+      outErrs[s] = r[4];
+      outCount[s] = static_cast<int>(r[5]);
+      outSpread[s] = r[6];
+    }
+    eckit::LocalConfiguration list;
+    list.set("lats", outLats);
+    list.set("lons", outLons);
+    list.set("datetimes", outTimes);
+    eckit::LocalConfiguration generate;
+    generate.set("list", list);
+    generate.set("obs errors", std::vector<double>{1.0});
+    eckit::LocalConfiguration outConf(fullConfig, "output");
+    outConf.set("generate", generate);
+
+    // the output obs space of the first PE alone holds all the locations in
+    // the order of the list, written when it goes out of scope
+    ioda::ObsSpace obsout(outConf, oops::mpi::myself(), winbgn, winend);
+    obsout.put_db("ObsValue", var, outVals);
+    obsout.put_db("ObsError", var, outErrs);
+    obsout.put_db("PreQC", var, outQc);
+    obsout.put_db("MetaData", "superob_count", outCount);
+    obsout.put_db("MetaData", "superob_spread", outSpread);
+
+    return 0;
+  }
+
+// ----------------------------------------------------------------------------
+
+}  // namespace umdsst
@@ -0,0 +1,62 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_SUPEROB_SUPEROB_H_
+#define UMDSST_SUPEROB_SUPEROB_H_
+
+#include <string>
+
+#include "oops/mpi/mpi.h"
+#include "oops/runs/Application.h"
+
+// forward declarations
+namespace eckit {
+  class Configuration;
+}
+
+// ----------------------------------------------------------------------------
+
+namespace umdsst {
+
+  // Superobbing of dense (satellite) observations onto the grid of the
+  // Geometry, as a reduction of the observations before the var that keeps
+  // their information, unlike a random thinning.
+  //
+  // The observations of the "input" obs space are binned by the grid point
+  // nearest to them, with the O(1) cell lookup of the regular grid. Each
+  // observation is sent to the PE that owns its grid point, which keeps
+  // running (Welford) moments of the bins, so the bins are built in
+  // parallel in one all to all. A bin with at least "minimum count"
+  // observations over the ocean gives one superobservation at its grid
+  // point and at the mean time of its observations, with the mean value
+  // and an error of
+  //
+  //   sigma^2 = (mean(sigma_o^2) + spread^2) / n
+  //
+  // where spread is the standard deviation of the observations in the bin.
+  // The count and the spread are written as MetaData. The superobservations
+  // are on grid points, so H is a plain gather (see StructuredInterpolator).
+  //
+  // "max preqc" leaves out the observations with a larger PreQC before the
+  // binning. The superobservations are sent once to the first PE, where the
+  // "output" obs space is generated from their list and written through its
+  // "obsdataout" as one file (with the rank suffix of ioda, "_0000").
+  class SuperOb : public oops::Application {
+   public:
+    explicit SuperOb(const eckit::mpi::Comm & comm = oops::mpi::world())
+      : Application(comm) {}
+    virtual ~SuperOb() {}
+
+    int execute(const eckit::Configuration &) const override;
+
+   private:
+    std::string appname() const override {return "umdsst::SuperOb";}
+  };
+
+}  // namespace umdsst
+
+#endif  // UMDSST_SUPEROB_SUPEROB_H_
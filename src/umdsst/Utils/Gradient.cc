@@ -0,0 +1,88 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "umdsst/Geometry/Geometry.h"
+#include "umdsst/Utils/Gradient.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
+#include "atlas/grid.h"
+#include "atlas/option.h"
+#include "atlas/util/Earth.h"
+
+using atlas::array::make_view;
+
+namespace umdsst {
+
+// ----------------------------------------------------------------------------
+
+  void horizontalGradient(const Geometry & geom, const double * x,
+                          const std::vector<int> & valid,
+                          std::vector<double> & gx, std::vector<double> & gy) {
+    const atlas::functionspace::StructuredColumns & fs =
+      *geom.atlasFunctionSpace();
+    const atlas::functionspace::StructuredColumns & haloFs =
+      *geom.atlasFunctionSpaceHalo();
+    const atlas::StructuredGrid & grid = fs.grid();
+    const int ny = static_cast<int>(grid.ny());
+    gx.assign(fs.size(), 0.0);
+    gy.assign(fs.size(), 0.0);
+
+    // the field and whether it is valid, with their halo
+    atlas::Field work = haloFs.createField<double>(atlas::option::levels(2));
+    auto work_view = make_view<double, 2>(work);
+    for (int j = fs.j_begin(); j < fs.j_end(); j++) {
+      for (int i = fs.i_begin(j); i < fs.i_end(j); i++) {
+        const int k = fs.index(i, j);
+        const int h = haloFs.index(i, j);
+        work_view(h, 0) = valid[k] ? x[k] : 0.0;
+        work_view(h, 1) = valid[k];
+      }
+    }
+    haloFs.haloExchange(work);
+
+    const double radius = atlas::util::DatumIFS::radius();
+    const double dlon = 2.0 * M_PI / grid.nxmax();
+    const double dlat = ny > 1 ? std::abs(grid.y(1) - grid.y(0))*M_PI/180.0
+                               : M_PI;
+
+    // derivative along a line from the point and its two neighbors m and p
+    auto derivative = [&work_view](const int h, const int hm, const bool hasM,
+                                   const int hp, const bool hasP,
+                                   const double ds) {
+      const bool m = hasM && work_view(hm, 1) != 0.0;
+      const bool p = hasP && work_view(hp, 1) != 0.0;
+      if (m && p) return (work_view(hp, 0) - work_view(hm, 0)) / (2.0*ds);
+      if (p) return (work_view(hp, 0) - work_view(h, 0)) / ds;
+      if (m) return (work_view(h, 0) - work_view(hm, 0)) / ds;
+      return 0.0;
+    };
+
+    // j increases southward
+    const double dy = radius * dlat;
+    for (int j = fs.j_begin(); j < fs.j_end(); j++) {
+      const double dx = radius * std::max(std::cos(grid.y(j)*M_PI/180.0),
+                                          1.0e-6) * dlon;
+      for (int i = fs.i_begin(j); i < fs.i_end(j); i++) {
+        const int k = fs.index(i, j);
+        if (!valid[k]) continue;
+        const int h = haloFs.index(i, j);
+        gx[k] = derivative(h, haloFs.index(i-1, j), true,
+                           haloFs.index(i+1, j), true, dx);
+        gy[k] = derivative(h, j < ny-1 ? haloFs.index(i, j+1) : h, j < ny-1,
+                           j > 0 ? haloFs.index(i, j-1) : h, j > 0, dy);
+      }
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+}  // namespace umdsst
@@ -0,0 +1,27 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_UTILS_GRADIENT_H_
+#define UMDSST_UTILS_GRADIENT_H_
+
+#include <vector>
+
+namespace umdsst {
+  class Geometry;
+
+  // The horizontal gradient (eastward and northward, per meter) of a single
+  // level field on the owned points of the geometry. Centered differences,
+  // one-sided next to the points that are not valid and at the poles, and 0
+  // along a direction where neither neighbor is valid. Points that are not
+  // valid get 0.
+  void horizontalGradient(const Geometry &, const double * x,
+                          const std::vector<int> & valid,
+                          std::vector<double> & gx, std::vector<double> & gy);
+
+}  // namespace umdsst
+
+#endif  // UMDSST_UTILS_GRADIENT_H_
@@ -0,0 +1,106 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_UTILS_GRIDCELLS_H_
+#define UMDSST_UTILS_GRIDCELLS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "atlas/functionspace.h"
+#include "atlas/grid.h"
+
+#include "eckit/mpi/Comm.h"
+
+namespace umdsst {
+
+  // The cell of the grid around a location, and the bilinear weights of its
+  // corners (i1, j1) relative to (i0, j0).
+  struct Cell {
+    int i0, i1, j0, j1;
+    double wx, wy;
+
+    // the grid point nearest to the location
+    int i() const { return wx < 0.5 ? i0 : i1; }
+    int j() const { return wy < 0.5 ? j0 : j1; }
+  };
+
+  // O(1) lookup of the cells of a global regular lon-lat grid, from the
+  // grid spacing. The columns are cyclic, and the rows can go either north
+  // to south or south to north. Beyond the first and last rows (near the
+  // poles) the cell is flat on the nearest row.
+  class GridCells {
+   public:
+    explicit GridCells(const atlas::RegularLonLatGrid & grid)
+      : nx_(grid.nx()), ny_(grid.ny()), x0_(grid.x(0)), dx_(360.0 / nx_),
+        y0_(grid.y(0)), dy_(ny_ > 1 ? grid.y(1) - grid.y(0) : 1.0) {}
+
+    Cell cell(const double lon, const double lat) const {
+      Cell c;
+      double s = (lon - x0_) / dx_;
+      s -= nx_ * std::floor(s / nx_);
+      c.i0 = std::min(static_cast<int>(s), nx_-1);
+      c.i1 = (c.i0 + 1) % nx_;
+      c.wx = s - c.i0;
+
+      const double t = (lat - y0_) / dy_;
+      c.j0 = c.j1 = 0;
+      c.wy = 0.0;
+      if (t >= ny_-1) {
+        c.j0 = c.j1 = ny_-1;
+      } else if (t > 0.0) {
+        c.j0 = static_cast<int>(t);
+        c.j1 = c.j0 + 1;
+        c.wy = t - c.j0;
+      }
+      return c;
+    }
+
+   private:
+    int nx_, ny_;
+    double x0_, dx_, y0_, dy_;
+  };
+
+  // The PE that owns any point of the grid, from the column ranges of the
+  // rows of every PE (one all to all at construction).
+  class PointOwners {
+   public:
+    PointOwners(const atlas::functionspace::StructuredColumns & fs,
+                const eckit::mpi::Comm & comm)
+      : npe_(comm.size()), rowStart_(fs.grid().ny()) {
+      std::vector<int> myRows;
+      for (int j = fs.j_begin(); j < fs.j_end(); j++) {
+        myRows.push_back(j);
+        myRows.push_back(fs.i_begin(j));
+        myRows.push_back(fs.i_end(j));
+      }
+      std::vector<std::vector<int>> sendRows(npe_, myRows), recvRows(npe_);
+      comm.allToAll(sendRows, recvRows);
+      for (int p = 0; p < npe_; p++)
+        for (size_t r = 0; r < recvRows[p].size(); r += 3)
+          if (recvRows[p][r+1] < recvRows[p][r+2])
+            rowStart_[recvRows[p][r]].push_back(
+              std::make_pair(recvRows[p][r+1], p));
+      for (auto & row : rowStart_) std::sort(row.begin(), row.end());
+    }
+
+    int owner(const int i, const int j) const {
+      const std::vector<std::pair<int, int>> & row = rowStart_[j];
+      return (std::upper_bound(row.begin(), row.end(),
+                               std::make_pair(i, npe_)) - 1)->second;
+    }
+
+   private:
+    int npe_;
+    std::vector<std::vector<std::pair<int, int>>> rowStart_;
+  };
+
+}  // namespace umdsst
+
+#endif  // UMDSST_UTILS_GRIDCELLS_H_
@@ -0,0 +1,53 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_UTILS_HASH_H_
+#define UMDSST_UTILS_HASH_H_
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace umdsst {
+
+  // 64 bit FNV-1a hash, used to build the keys of on-disk caches.
+  inline uint64_t hashBytes(const void * data, const size_t size,
+                            uint64_t h = 14695981039346656037ULL) {
+    const unsigned char * p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++) {
+      h ^= p[i];
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  inline uint64_t hashString(const std::string & str,
+                             uint64_t h = 14695981039346656037ULL) {
+    return hashBytes(str.data(), str.size(), h);
+  }
+
+  // scramble two 64 bit words (splitmix64 finalizer). Summing mix(index,
+  // value) over the points of a distributed field gives a hash that does not
+  // depend on the order of the points or on how they are split across PEs.
+  inline uint64_t hashMix(const uint64_t a, const uint64_t b) {
+    uint64_t z = a * 0x9E3779B97F4A7C15ULL + b;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  // hash as a fixed width hex string, used for file/directory names
+  inline std::string hashHex(const uint64_t h) {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016" PRIx64, h);
+    return std::string(buf);
+  }
+
+}  // namespace umdsst
+
+#endif  // UMDSST_UTILS_HASH_H_
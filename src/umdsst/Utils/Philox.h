@@ -0,0 +1,72 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#ifndef UMDSST_UTILS_PHILOX_H_
+#define UMDSST_UTILS_PHILOX_H_
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace umdsst {
+
+  // Counter based random number generator (Philox4x32-10, Salmon et al.
+  // 2011). Each output is a pure function of a counter and a key, there is
+  // no state to advance. Using the global index of a grid point as the
+  // counter gives the same random field on any number of PEs, and every point
+  // can be generated independently (threaded and vectorized).
+  class Philox {
+   public:
+    typedef std::array<uint32_t, 4> Counter;
+
+    explicit Philox(const uint64_t seed)
+      : key0_(static_cast<uint32_t>(seed)),
+        key1_(static_cast<uint32_t>(seed >> 32)) {}
+
+    // 4 random 32 bit integers for the given counter
+    Counter operator()(Counter ctr) const {
+      uint32_t k0 = key0_, k1 = key1_;
+      for (int r = 0; r < 10; r++) {
+        if (r > 0) {
+          k0 += 0x9E3779B9;
+          k1 += 0xBB67AE85;
+        }
+        const uint64_t p0 = static_cast<uint64_t>(0xD2511F53) * ctr[0];
+        const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57) * ctr[2];
+        ctr = {{static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ k0,
+                static_cast<uint32_t>(p1),
+                static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ k1,
+                static_cast<uint32_t>(p0)}};
+      }
+      return ctr;
+    }
+
+    // a sample of N(0,1) for the given point (1 based global index), level,
+    // variable and ensemble member
+    double normal(const uint64_t gidx, const uint32_t lev,
+                  const uint32_t var, const uint32_t member) const {
+      const Counter r = (*this)({{static_cast<uint32_t>(gidx),
+                                  static_cast<uint32_t>(gidx >> 32) ^ lev,
+                                  var, member}});
+      // Box-Muller, with two uniform (0,1) doubles of 53 bits each
+      const double u1 = uniform(r[0], r[1]);
+      const double u2 = uniform(r[2], r[3]);
+      return std::sqrt(-2.0*std::log(u1)) * std::cos(2.0*M_PI*u2);
+    }
+
+   private:
+    static double uniform(const uint32_t a, const uint32_t b) {
+      return ((a >> 5)*67108864.0 + (b >> 6) + 0.5) / 9007199254740992.0;
+    }
+
+    const uint32_t key0_;
+    const uint32_t key1_;
+  };
+
+}  // namespace umdsst
+
+#endif  // UMDSST_UTILS_PHILOX_H_
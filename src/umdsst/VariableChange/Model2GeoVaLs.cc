@@ -5,6 +5,8 @@
  * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
  */
 
+#include <algorithm>
+
 #include "umdsst/VariableChange/Model2GeoVaLs.h"
 
 #include "atlas/array.h"
@@ -34,12 +36,17 @@ Model2GeoVaLs::Model2GeoVaLs(const Geometry & geom,
 void Model2GeoVaLs::changeVar(const State & xin, State & xout) const {
   const int size = geom_->atlasFunctionSpace()->size();
 
-  for ( int i = 0; i < xout.variables().size(); i++ ) {
+  for ( size_t i = 0; i < xout.variables().size(); i++ ) {
     std::string name = xout.variables()[i];
 
     if ( xin.variables().has(name) ) {
-      // variable is simply being copied from xin to xout
-      xout.atlasFieldSet()->field(name) = xin.atlasFieldSet()->field(name);
+      // variable is simply being copied from xin to xout. (The data is
+      // copied, rebinding the atlas::Field would leave xout pointing at
+      // stale storage.)
+      auto fd = atlas::array::make_view<double, 2>(
+          xout.atlasFieldSet()->field(name));
+      const double * fd_src = xin.fieldData(name);
+      std::copy(fd_src, fd_src + fd.size(), fd.data());
 
     } else if (name == "sea_area_fraction") {
       // convert integer land mask to a floating point field
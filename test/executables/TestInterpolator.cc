@@ -0,0 +1,273 @@
+/*
+ * (C) Copyright 2021-2021 UCAR, University of Maryland
+ *
+ * This software is licensed under the terms of the Apache Licence Version 2.0
+ * which can be obtained at http://www.apache.org/licenses/LICENSE-2.0.
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "umdsst/Geometry/Geometry.h"
+#include "umdsst/GetValues/StructuredInterpolator.h"
+#include "umdsst/GetValues/TimeInterpolation.h"
+
+#include "eckit/config/LocalConfiguration.h"
+#include "eckit/testing/Test.h"
+
+#include "atlas/array.h"
+#include "atlas/field.h"
+#include "atlas/functionspace.h"
+#include "atlas/grid.h"
+#include "atlas/option.h"
+
+#include "oops/mpi/mpi.h"
+#include "oops/runs/Run.h"
+#include "oops/runs/Test.h"
+#include "oops/util/DateTime.h"
+#include "oops/util/Duration.h"
+#include "oops/util/missingValues.h"
+
+#include "test/TestEnvironment.h"
+
+using atlas::array::make_view;
+
+namespace umdsst {
+namespace test {
+
+// ----------------------------------------------------------------------------
+
+  // the tests of the features of the StructuredInterpolator that the generic
+  // GetValues tests cannot see, on quasi-random locations of the window
+  // that differ between the PEs
+  struct Fixture {
+    Fixture()
+      : conf(::test::TestEnvironment::config(), "interpolator test"),
+        geom(eckit::LocalConfiguration(::test::TestEnvironment::config(),
+                                       "geometry"), oops::mpi::world()),
+        bgn(conf.getString("window begin")),
+        end(conf.getString("window end")) {
+      const size_t n = conf.getInt("locations");
+      const size_t rank = oops::mpi::world().rank();
+      const int64_t len = (end - bgn).toSeconds();
+      for (size_t k = 0; k < n; k++) {
+        const double u = k + n*rank + 1;
+        lons.push_back(-180.0 + 360.0*std::fmod(u*0.6180339887, 1.0));
+        lats.push_back(-75.0 + 165.0*std::fmod(u*0.7548776662, 1.0));
+        times.push_back(bgn + util::Duration((k+1)*len / n));
+      }
+    }
+
+    // a grid field that varies in both directions
+    atlas::Field gridField() const {
+      const atlas::functionspace::StructuredColumns & fs =
+        *geom.atlasFunctionSpace();
+      atlas::Field fld = fs.createField<double>(atlas::option::levels(1));
+      auto xy = make_view<double, 2>(fs.xy());
+      auto f = make_view<double, 2>(fld);
+      for (int n = 0; n < fs.size(); n++)
+        f(n, 0) = xy(n, 0) + 1000.0*xy(n, 1);
+      return fld;
+    }
+
+    atlas::Field locField() const {
+      atlas::Field fld("y", atlas::array::make_datatype<double>(),
+                       atlas::array::make_shape(lons.size(), 1));
+      make_view<double, 2>(fld).assign(0.0);
+      return fld;
+    }
+
+    // the values of all the locations of the window
+    std::vector<double> interpolate(const StructuredInterpolator & interp,
+                                    const atlas::Field & src) const {
+      atlas::Field dst = locField();
+      interp.apply(src, dst, bgn, end);
+      const double * y = make_view<double, 2>(dst).data();
+      return std::vector<double>(y, y + lons.size());
+    }
+
+    const eckit::LocalConfiguration conf;
+    const Geometry geom;
+    const util::DateTime bgn;
+    const util::DateTime end;
+    std::vector<double> lons, lats;
+    std::vector<util::DateTime> times;
+  };
+
+// ----------------------------------------------------------------------------
+
+  // the stencils of the same locations are shared in memory, and read back
+  // from the disk once they are no longer in memory
+  void testStencilCache() {
+    const Fixture fix;
+    const StructuredInterpolator first(fix.geom, fix.lons, fix.lats,
+                                       fix.times, fix.conf);
+    const StructuredInterpolator second(fix.geom, fix.lons, fix.lats,
+                                        fix.times, fix.conf);
+    EXPECT(second.sharesStencils(first));
+    EXPECT(!second.stencilsRead());
+
+    // with no memory entries, the entry is taken out of the memory cache by
+    // the next construction, and the one after reads the disk
+    eckit::LocalConfiguration conf(fix.conf);
+    conf.set("stencil cache.memory entries", 0);
+    const StructuredInterpolator taken(fix.geom, fix.lons, fix.lats,
+                                       fix.times, conf);
+    EXPECT(taken.sharesStencils(first));
+    const StructuredInterpolator read(fix.geom, fix.lons, fix.lats,
+                                      fix.times, conf);
+    EXPECT(!read.sharesStencils(first));
+    EXPECT(read.stencilsRead());
+
+    const atlas::Field src = fix.gridField();
+    EXPECT(fix.interpolate(read, src) == fix.interpolate(first, src));
+  }
+
+// ----------------------------------------------------------------------------
+
+  // interpolating each location on the PE that owns its grid cell gives the
+  // values, and the adjoint, of interpolating it on its own PE
+  void testRedistribute() {
+    const Fixture fix;
+    eckit::LocalConfiguration conf(fix.conf);
+    conf.set("redistribute locations", true);
+    const StructuredInterpolator local(fix.geom, fix.lons, fix.lats,
+                                       fix.times, fix.conf);
+    const StructuredInterpolator moved(fix.geom, fix.lons, fix.lats,
+                                       fix.times, conf);
+    const double tol = fix.conf.getDouble("tolerance");
+
+    const atlas::Field src = fix.gridField();
+    const std::vector<double> y1 = fix.interpolate(local, src);
+    const std::vector<double> y2 = fix.interpolate(moved, src);
+    for (size_t n = 0; n < y1.size(); n++)
+      EXPECT(std::abs(y2[n] - y1[n]) <= tol*std::abs(y1[n]));
+
+    atlas::Field dy = fix.locField();
+    auto d = make_view<double, 2>(dy);
+    for (size_t n = 0; n < fix.lons.size(); n++) d(n, 0) = 1.0 + n % 7;
+    const atlas::functionspace::StructuredColumns & fs =
+      *fix.geom.atlasFunctionSpace();
+    atlas::Field dx1 = fs.createField<double>(atlas::option::levels(1));
+    atlas::Field dx2 = fs.createField<double>(atlas::option::levels(1));
+    make_view<double, 2>(dx1).assign(0.0);
+    make_view<double, 2>(dx2).assign(0.0);
+    local.applyAD(dy, dx1, fix.bgn, fix.end);
+    moved.applyAD(dy, dx2, fix.bgn, fix.end);
+    auto x1 = make_view<double, 2>(dx1);
+    auto x2 = make_view<double, 2>(dx2);
+    for (int n = 0; n < fs.sizeOwned(); n++)
+      EXPECT(std::abs(x2(n, 0) - x1(n, 0)) <= tol*std::abs(x1(n, 0)) + tol);
+  }
+
+// ----------------------------------------------------------------------------
+
+  // blending hourly states, whose values are their hour in the window, gives
+  // the time of each location in hours, and the weights of the adjoint of
+  // each location add up to 1, in the slots of the states as oops gives them
+  void testTimeBlend() {
+    const Fixture fix;
+    eckit::LocalConfiguration conf;
+    conf.set("time interpolation", "linear");
+    TimeInterpolation time(fix.times, conf);
+    EXPECT(time.linear());
+    const double tol = fix.conf.getDouble("tolerance");
+    const size_t nlocs = fix.times.size();
+    const util::Duration step(3600), half(1800);
+
+    std::vector<util::DateTime> states;
+    for (util::DateTime t = fix.bgn; t <= fix.end; t += step)
+      states.push_back(t);
+    std::vector<double> y(nlocs, 0.0);
+    for (const util::DateTime & t : states) {
+      const util::DateTime t1 = t - half < fix.bgn ? fix.bgn : t - half;
+      const util::DateTime t2 = t + half > fix.end ? fix.end : t + half;
+      time.begin(t, t1, t2);
+      const std::vector<double> x(nlocs, (t - fix.bgn).toSeconds() / 3600.0);
+      time.blend(x.data(), y.data(), t);
+    }
+
+    const std::vector<double> ones(nlocs, 1.0);
+    std::vector<double> sum(nlocs, 0.0), hours(nlocs, 0.0);
+    for (const util::DateTime & t : states) {
+      std::vector<double> w(nlocs, 0.0);
+      time.weight(ones.data(), w.data(), t);
+      for (size_t n = 0; n < nlocs; n++) {
+        sum[n] += w[n];
+        hours[n] += w[n] * (t - fix.bgn).toSeconds() / 3600.0;
+      }
+    }
+
+    for (size_t n = 0; n < nlocs; n++) {
+      const double tau = (fix.times[n] - fix.bgn).toSeconds() / 3600.0;
+      EXPECT(std::abs(y[n] - tau) <= tol*(1.0 + tau));
+      EXPECT(std::abs(sum[n] - 1.0) <= tol);
+      EXPECT(std::abs(hours[n] - tau) <= tol*(1.0 + tau));
+    }
+  }
+
+// ----------------------------------------------------------------------------
+
+  // locations on grid points get the value of their point (missing on land)
+  // through stencils of width 1, a single location off the grid brings back
+  // the bilinear stencils of width 4
+  void testOnGrid() {
+    Fixture fix;
+    const atlas::RegularLonLatGrid grid(fix.geom.atlasFunctionSpace()->grid());
+    const size_t rank = oops::mpi::world().rank();
+    for (size_t n = 0; n < fix.lons.size(); n++) {
+      fix.lons[n] = grid.x((37*n + 11*rank) % grid.nx());
+      fix.lats[n] = grid.y((53*n + 7*rank) % grid.ny());
+    }
+    const StructuredInterpolator onGrid(fix.geom, fix.lons, fix.lats,
+                                        fix.times, fix.conf);
+    EXPECT(onGrid.stencilWidth() == 1);
+
+    const double missing = util::missingValue(missing);
+    const std::vector<double> y = fix.interpolate(onGrid, fix.gridField());
+    for (size_t n = 0; n < y.size(); n++)
+      EXPECT(y[n] == missing || y[n] == fix.lons[n] + 1000.0*fix.lats[n]);
+
+    fix.lons[0] += 0.25;
+    const StructuredInterpolator offGrid(fix.geom, fix.lons, fix.lats,
+                                         fix.times, fix.conf);
+    EXPECT(offGrid.stencilWidth() == 4);
+  }
+
+// ----------------------------------------------------------------------------
+
+  class Interpolator : public oops::Test {
+   public:
+    Interpolator() {}
+    virtual ~Interpolator() {}
+
+   private:
+    std::string testid() const override {return "umdsst::test::Interpolator";}
+
+    void register_tests() const override {
+      std::vector<eckit::testing::Test>& ts = eckit::testing::specification();
+
+      ts.emplace_back(CASE("umdsst/Interpolator/testStencilCache")
+        { testStencilCache(); });
+      ts.emplace_back(CASE("umdsst/Interpolator/testRedistribute")
+        { testRedistribute(); });
+      ts.emplace_back(CASE("umdsst/Interpolator/testTimeBlend")
+        { testTimeBlend(); });
+      ts.emplace_back(CASE("umdsst/Interpolator/testOnGrid")
+        { testOnGrid(); });
+    }
+
+    void clear() const override {}
+  };
+
+// ----------------------------------------------------------------------------
+
+}  // namespace test
+}  // namespace umdsst
+
+int main(int argc,  char ** argv) {
+  oops::Run run(argc, argv);
+  umdsst::test::Interpolator tests;
+  return run.execute(tests);
+}